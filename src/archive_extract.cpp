@@ -0,0 +1,47 @@
+/*
+Renders solutions from an archive written by batch_solver --archive (see
+solution_archive.hpp) as bitmaps.
+
+With only the archive given, lists the names in it. Given a name, writes
+that solution to the output file, or to the name with ".bmp" appended.
+*/
+
+#include "solution_archive.hpp"
+
+#include <iostream>
+#include <string>
+
+int main(int argc, char* argv[])
+{
+	if (argc < 2 || 4 < argc)
+	{
+		std::cerr << "usage: " << argv[0] << " archive [name [outfile]]\n";
+		return 1;
+	}
+
+	archive_reader archive;
+	if (!archive.open(argv[1]))
+	{
+		std::cerr << "Could not read archive \"" << argv[1] << "\".\n";
+		return 1;
+	}
+
+	if (argc == 2)
+	{
+		for (std::size_t i = 0; i < archive.names(); ++i)
+			std::cout << archive.name(i) << '\n';
+		return 0;
+	}
+
+	const auto grid = archive.find(argv[2]);
+	if (!grid)
+	{
+		std::cerr << "No solution named \"" << argv[2] << "\" in the archive.\n";
+		return 1;
+	}
+
+	const std::string outFileName = (argc == 4) ? argv[3] : std::string(argv[2]) + ".bmp";
+	grid->bitmap().write(outFileName);
+
+	std::cout << "Solution image written to file \"" << outFileName << "\"." << std::endl;
+}
@@ -0,0 +1,63 @@
+#include "async_writer.hpp"
+
+#include <fstream>
+
+async_writer::async_writer(std::size_t max_bytes) : max_pending(max_bytes)
+{
+	writer = std::thread([this] { run(); });
+}
+
+async_writer::~async_writer() { finish(); }
+
+void async_writer::run()
+{
+	std::unique_lock lock(mut);
+	while (true)
+	{
+		changed.wait(lock, [this] { return !queue.empty() || done; });
+		if (queue.empty())
+			return;
+
+		auto next = std::move(queue.front());
+		queue.pop_front();
+
+		lock.unlock();
+
+		std::ofstream out(next.path, std::ios_base::binary);
+		out.write(next.data->data(), static_cast<std::streamsize>(next.data->size()));
+		out.close();
+
+		lock.lock();
+
+		pending -= next.data->size();
+		if (!out)
+			failed.push_back(std::move(next.path));
+		changed.notify_all();
+	}
+}
+
+void async_writer::write(std::filesystem::path path, std::shared_ptr<const std::string> data)
+{
+	std::unique_lock lock(mut);
+
+	const auto size = data->size();
+	changed.wait(lock, [&] { return pending == 0 || pending + size <= max_pending; });
+
+	queue.push_back({std::move(path), std::move(data)});
+	pending += size;
+	changed.notify_all();
+}
+
+std::vector<std::filesystem::path> async_writer::finish()
+{
+	{
+		std::lock_guard lock(mut);
+		done = true;
+	}
+	changed.notify_all();
+
+	if (writer.joinable())
+		writer.join();
+
+	return std::move(failed);
+}
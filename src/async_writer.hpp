@@ -0,0 +1,58 @@
+#pragma once
+
+/*
+Writes files on a thread of its own, so that whoever produces them can carry
+on while slow disks or network mounts catch up. Each file is handed over
+already serialized. Once the files waiting to be written add up to the limit
+given on construction, further writes block until enough of them are done,
+so memory held stays bounded however far behind the disk falls.
+*/
+
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class async_writer
+{
+	struct job
+	{
+		std::filesystem::path path;
+		std::shared_ptr<const std::string> data;
+	};
+
+	const std::size_t max_pending;
+
+	std::mutex mut;
+	std::condition_variable changed;
+	std::deque<job> queue;
+	std::size_t pending = 0;
+	bool done = false;
+	std::vector<std::filesystem::path> failed;
+
+	// Started last, once everything it uses is in place.
+	std::thread writer;
+
+	void run();
+
+  public:
+	// Allows up to 'max_bytes' of files to be waiting at once. A single file
+	// larger than that is still written, just never alongside others.
+	explicit async_writer(std::size_t max_bytes);
+
+	async_writer(const async_writer&) = delete;
+	async_writer& operator=(const async_writer&) = delete;
+
+	~async_writer();
+
+	// Queues 'data' to be written to 'path'. Safe to call from several threads.
+	void write(std::filesystem::path path, std::shared_ptr<const std::string> data);
+
+	// Waits for every queued file to be written, and returns those that
+	// could not be. No more files may be queued afterwards.
+	std::vector<std::filesystem::path> finish();
+};
@@ -1,91 +1,1050 @@
-#include "nonagram.hpp"
+/*
+Solves every puzzle in a folder, writing the solutions to another folder.
+
+Once every puzzle is done, a table of results is printed in the order of the
+(sorted) input file names, so that runs can be diffed against each other.
+If a report file is given, the results are also written there, as JSON if
+its name ends in ".json" and as CSV otherwise.
+
+Colored puzzles (see color_nonagram.hpp) are solved too, but are not cached,
+rated, grouped with their duplicates or line solved in lockstep, and cannot
+go into an archive.
+
+Puzzles are read and solved a chunk at a time, so that only a few per worker
+are held at once, however large the batch.
+
+Puzzles with the same hints are only solved once per run. With --cache,
+solutions are also kept in the given folder across runs (see
+solution_cache.hpp), and puzzles found there are not solved again unless
+--force is given.
+
+With --memory, each search gives up once copies of its puzzle would take more
+than the given number of megabytes.
+
+With --rate, each puzzle is also rated by the weakest technique that solves it
+(see nonagram::rate()), and the rating and the effort it took are reported.
+Rating always solves the puzzle, so the cache is only written to, not read.
+
+Solutions are written out on a thread of their own while solving carries on.
+--output-buffer limits how many megabytes of them may wait to be written
+(64 by default), past which solving waits for the disk to catch up.
+
+With --lockstep, puzzles small enough for lockstep_batch are line solved
+together in batches, with no nonagram built for them, and only those that
+line solving cannot finish are searched the usual way. Those it does finish
+are not cached, rated or grouped with their duplicates.
 
-#include "ctpl_stl.h"
+With --checkpoint, a search saves its progress every given number of seconds
+next to where its solution is to go, with the extension ".checkpoint", and
+removes the file once done. With --resume, a search finding such a file picks
+up from it, so that a run that was stopped need not start its longest
+searches over; it also implies --checkpoint 60 if that is not given.
 
+With --archive, solutions are not written as one bitmap each, but appended to
+the given archive file (see solution_archive.hpp) under the file names of
+their input files, which are unique within the input folder, and
+archive_extract renders them on demand. The reports then name the archive as
+every solution's output.
+
+Work is spread over --threads worker threads, one per hardware thread by
+default. With --pin, each is pinned to a CPU of its own, cores before second
+hardware threads and alternating between sockets (see spreadCpus()). Workers
+live for the whole run and keep their buffers from one puzzle to the next,
+and how busy each one was is reported at the end. A search splitting its
+puzzle into parts (see nonagram::solve()) only gets its worker's share of
+the hardware threads, and none beyond its worker's with --pin.
+
+With --queue, several batch_solver processes, on this host or on others
+mounting the same file systems, share out the puzzles through the given
+directory (see work_queue.hpp), in shards of --shard-size puzzles (100 by
+default). Each process keeps claiming shards until every one is done,
+taking over those whose process has not touched its lease for --lease
+seconds (60 by default), and reports on the shards it solved. The report
+file, which must then be CSV, covers every shard and is written by each
+process as it finishes. --archive cannot be used with --queue.
+
+The summary reports how many puzzles were solved per second of the whole run.
+*/
+
+#include "async_writer.hpp"
+#include "color_nonagram.hpp"
+#include "lockstep.hpp"
+#include "nonagram.hpp"
+#include "peak_memory.hpp"
+#include "solution_archive.hpp"
+#include "solution_cache.hpp"
+#include "work_queue.hpp"
+#include "worker_pool.hpp"
+
+#include <algorithm>
 #include <chrono>
+#include <cstdlib>
 #include <filesystem>
 #include <fstream>
+#include <iomanip>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <span>
+#include <sstream>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 
 namespace stdfs = std::filesystem;
 
-void parseArgs(int argc, const char* argv[])
+struct options
+{
+	stdfs::path infolder, outfolder, report, cache, archive, queue;
+	bool force = false, rate = false, lockstep = false, pin = false;
+	unsigned threads = std::max(std::thread::hardware_concurrency(), 1u);
+
+	// In bytes, 0 meaning no limit.
+	std::size_t memory_budget = 0;
+
+	// In bytes.
+	std::size_t output_buffer = std::size_t(64) << 20;
+
+	// Save progress every so many seconds, 0 meaning never.
+	unsigned checkpoint = 0;
+	bool resume = false;
+
+	// Puzzles per shard, and seconds before a lease is taken over.
+	unsigned shard_size = 100, lease = 60;
+};
+
+options parseArgs(int argc, const char* argv[])
 {
-	if (argc != 3)
+	options opts;
+	std::vector<const char*> positional;
+
+	for (int i = 1; i < argc; ++i)
 	{
-		std::cerr << "usage: " << argv[0] << " infolder outfolder\n";
+		const std::string_view arg = argv[i];
+		if (arg == "--force")
+			opts.force = true;
+		else if (arg == "--rate")
+			opts.rate = true;
+		else if (arg == "--lockstep")
+			opts.lockstep = true;
+		else if (arg == "--pin")
+			opts.pin = true;
+		else if (arg == "--threads" && i + 1 < argc)
+			opts.threads = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 10));
+		else if (arg == "--cache" && i + 1 < argc)
+			opts.cache = argv[++i];
+		else if (arg == "--archive" && i + 1 < argc)
+			opts.archive = argv[++i];
+		else if (arg == "--queue" && i + 1 < argc)
+			opts.queue = argv[++i];
+		else if (arg == "--shard-size" && i + 1 < argc)
+			opts.shard_size = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 10));
+		else if (arg == "--lease" && i + 1 < argc)
+			opts.lease = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 10));
+		else if (arg == "--memory" && i + 1 < argc)
+			opts.memory_budget = std::strtoull(argv[++i], nullptr, 10) << 20;
+		else if (arg == "--output-buffer" && i + 1 < argc)
+			opts.output_buffer = std::strtoull(argv[++i], nullptr, 10) << 20;
+		else if (arg == "--checkpoint" && i + 1 < argc)
+			opts.checkpoint = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 10));
+		else if (arg == "--resume")
+			opts.resume = true;
+		else
+			positional.push_back(argv[i]);
+	}
+
+	if (positional.size() < 2 || 3 < positional.size())
+	{
+		std::cerr << "usage: " << argv[0]
+				  << " [--cache folder [--force]] [--memory MB] [--output-buffer MB] [--rate]"
+					 " [--lockstep] [--checkpoint seconds] [--resume] [--archive file]"
+					 " [--threads N] [--pin] [--queue folder [--shard-size N] [--lease seconds]]"
+					 " infolder outfolder [report.csv|report.json]\n";
 		exit(1);
 	}
+
+	opts.threads = std::max(opts.threads, 1u);
+	opts.lease = std::max(opts.lease, 1u);
+
+	if (opts.resume && opts.checkpoint == 0)
+		opts.checkpoint = 60;
+
+	opts.infolder = positional[0];
+	opts.outfolder = positional[1];
+	if (positional.size() == 3)
+		opts.report = positional[2];
+
+	if (!opts.queue.empty() && (!opts.archive.empty() || opts.report.extension() == ".json"))
+	{
+		std::cerr << "--queue needs a CSV report, if any, and no --archive.\n";
+		exit(1);
+	}
+
+	return opts;
 }
 
-void solve(const stdfs::path& infile, const stdfs::path& outfile)
+// The outcome of one puzzle. Each is written by exactly one task,
+// so no locking is needed until they are all read back.
+struct result
 {
-	static std::mutex iomut;
+	enum class status_t
+	{
+		input_error,
+		// The hints fail nonagram::checkHints().
+		infeasible,
+		failure,
+		over_budget,
+		output_error,
+		solved
+	};
 
+	// Where the solution came from.
+	enum class source_t
+	{
+		search,
+		cache,
+		duplicate,
+		lockstep
+	};
+
+	stdfs::path infile, outfile;
+	status_t status = status_t::input_error;
+	source_t source = source_t::search;
+
+	// Durations in seconds. Output only covers encoding the solution and
+	// queuing it, as the writer thread does the rest.
+	double input_time = 0, solve_time = 0, output_time = 0, total_time = 0;
+	std::uint64_t nodes = 0;
+
+	// Why the puzzle is infeasible, if it is.
+	std::string problem;
+
+	// Only with --rate.
+	std::optional<nonagram::rating> rating;
+};
+
+const char* statusName(result::status_t status)
+{
+	switch (status)
+	{
+	case result::status_t::input_error:
+		return "input error";
+	case result::status_t::infeasible:
+		return "infeasible";
+	case result::status_t::failure:
+		return "failure";
+	case result::status_t::over_budget:
+		return "over budget";
+	case result::status_t::output_error:
+		return "output error";
+	default:
+		return "solved";
+	}
+}
+
+const char* sourceName(result::source_t source)
+{
+	switch (source)
+	{
+	case result::source_t::cache:
+		return "cache";
+	case result::source_t::duplicate:
+		return "duplicate";
+	case result::source_t::lockstep:
+		return "lockstep";
+	default:
+		return "search";
+	}
+}
+
+const char* tierName(nonagram::tier level)
+{
+	switch (level)
+	{
+	case nonagram::tier::overlap:
+		return "overlap";
+	case nonagram::tier::line_solving:
+		return "line solving";
+	case nonagram::tier::probing:
+		return "probing";
+	case nonagram::tier::search:
+		return "search";
+	default:
+		return "unsolvable";
+	}
+}
+
+using seconds = std::chrono::duration<double>;
+
+// Where solutions go: bitmaps queued on the writer thread, or grids appended
+// to the archive if there is one.
+struct output
+{
+	async_writer& writer;
+	archive_writer* archive;
+};
+
+struct hint_lists
+{
+	std::vector<std::vector<unsigned>> rows, cols;
+};
+
+// What each worker thread keeps from one puzzle to the next, so that reading
+// and lockstep solving do not allocate afresh every time.
+struct worker_context
+{
+	hint_lists hints;
+	lockstep_batch batch;
+};
+
+/*-------------------------------------------------------------
+Reads a puzzle, leaving the status as an input error if it
+cannot be read. Colored puzzles are read into 'colored'. If
+'small' is given, puzzles that fit in a lockstep_batch only have
+their hints kept there. 'hints' is for scratch.
+-------------------------------------------------------------*/
+
+void read(result& res, nonagram& puzzle, std::string& key, std::optional<color_nonagram>& colored,
+          std::optional<hint_lists>* small, hint_lists& hints)
+{
 	auto start = std::chrono::steady_clock::now();
 
-	nonagram puzzle;
+	std::ifstream ifs(res.infile);
+
+	if (!ifs.is_open())
+		return;
+
+	if (isColorFormat(ifs))
 	{
-		std::ifstream ifs(infile);
+		if (!(ifs >> colored.emplace()))
+			colored.reset();
+		else
+			res.status = result::status_t::failure;
 
-		if (!ifs.is_open())
+		res.input_time = seconds(std::chrono::steady_clock::now() - start).count();
+		return;
+	}
+
+	if (!nonagram::readHints(ifs, hints.rows, hints.cols))
+		return;
+
+	if (const auto check = nonagram::checkHints(hints.rows, hints.cols); !check)
+	{
+		std::ostringstream reason;
+		reason << check;
+		res.problem = std::move(reason).str();
+		res.status = result::status_t::infeasible;
+		return;
+	}
+
+	if (small && hints.rows.size() <= lockstep_batch::max_cells &&
+	    hints.cols.size() <= lockstep_batch::max_cells)
+	{
+		// Copied, so that the scratch lists keep their capacity for the
+		// next puzzle.
+		*small = hints;
+	}
+	else
+	{
+		puzzle = nonagram(hints.rows, hints.cols);
+		key = solution_cache::key(puzzle);
+	}
+
+	res.status = result::status_t::failure;
+	res.input_time = seconds(std::chrono::steady_clock::now() - start).count();
+}
+
+/*-------------------------------------------------------------
+Solves a colored puzzle and queues its solution to be written
+out. Colored solutions cannot go into the archive, which only
+holds filled and empty cells.
+-------------------------------------------------------------*/
+
+void solveColor(result& res, color_nonagram& puzzle, output& dest)
+{
+	if (dest.archive)
+	{
+		res.status = result::status_t::output_error;
+		res.problem = "colored puzzles cannot be archived";
+		return;
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	const bool solved = puzzle.solve();
+	auto output_start = std::chrono::steady_clock::now();
+	res.solve_time = seconds(output_start - start).count();
+
+	if (solved)
+	{
+		res.status = result::status_t::solved;
+		auto data = std::make_shared<const std::string>(puzzle.bitmap().bytes());
+		dest.writer.write(res.outfile, std::move(data));
+		res.output_time = seconds(std::chrono::steady_clock::now() - output_start).count();
+	}
+	res.total_time = res.input_time + res.solve_time + res.output_time;
+}
+
+/*-------------------------------------------------------------
+Solves or rates one puzzle, or takes its solution from the
+cache, then queues it to be written out for every input file
+in 'group' (indexes into 'results', the first being the puzzle
+itself). Returns where the solution starts in the archive, if
+it went there.
+-------------------------------------------------------------*/
+
+std::optional<std::uint64_t> solve(std::span<result> results, std::span<const std::size_t> group,
+                                   nonagram& puzzle, const std::string& key,
+                                   const std::optional<solution_cache>& cache,
+                                   const options& opts, output& dest)
+{
+	auto& res = results[group[0]];
+
+	auto start = std::chrono::steady_clock::now();
+
+	bool solved = false;
+	if (cache && !opts.force && !opts.rate && cache->load(puzzle, key))
+	{
+		solved = true;
+		res.source = result::source_t::cache;
+	}
+	else
+	{
+		if (opts.rate)
+		{
+			res.rating = puzzle.rate();
+			solved = (res.rating->level != nonagram::tier::unsolvable);
+			res.nodes = res.rating->nodes;
+		}
+		else
 		{
-			std::lock_guard lock(iomut);
-			std::cout << infile << " input error\n";
-			return;
+			solved = puzzle.solve();
+			res.nodes = puzzle.searchNodes();
 		}
 
-		ifs >> puzzle;
+		if (puzzle.exceededMemoryBudget())
+			res.status = result::status_t::over_budget;
+
+		if (puzzle.checkpointFailed())
+			std::cerr << "Could not write the checkpoint for " << res.infile << ".\n";
+
+		if (solved && cache && !cache->store(puzzle, key))
+			std::cerr << "Could not write to the solution cache.\n";
 	}
 
-	auto input_done = std::chrono::steady_clock::now();
+	res.solve_time = seconds(std::chrono::steady_clock::now() - start).count();
 
-	if (!puzzle.solve())
+	// Every input file with these hints gets the same bytes, or the same
+	// grid in the archive.
+	std::shared_ptr<const std::string> data;
+	std::optional<std::uint64_t> grid;
+
+	for (const auto i : group)
 	{
-		std::lock_guard lock(iomut);
-		std::cout << infile << " failure\n";
-		return;
+		auto& out = results[i];
+		if (i != group[0])
+		{
+			out.source = result::source_t::duplicate;
+			out.status = res.status;
+			out.rating = res.rating;
+		}
+
+		if (solved)
+		{
+			auto output_start = std::chrono::steady_clock::now();
+
+			out.status = result::status_t::solved;
+			if (dest.archive)
+			{
+				if (!grid)
+				{
+					const auto cells = puzzle.cells();
+					const auto filled = std::make_unique<bool[]>(cells.size());
+					for (std::size_t pos = 0; pos < cells.size(); ++pos)
+						filled[pos] = (cells[pos] == nonagram::cell_state::filled);
+					grid = dest.archive->addGrid(puzzle.rows(), puzzle.cols(),
+					                             {filled.get(), cells.size()});
+				}
+
+				if (grid)
+					dest.archive->addName(out.infile.filename().string(), *grid);
+				else
+					out.status = result::status_t::output_error;
+			}
+			else
+			{
+				if (!data)
+					data = std::make_shared<const std::string>(puzzle.bitmap().bytes());
+				dest.writer.write(out.outfile, data);
+			}
+
+			out.output_time = seconds(std::chrono::steady_clock::now() - output_start).count();
+		}
+		out.total_time = out.input_time + out.solve_time + out.output_time;
+	}
+	return grid;
+}
+
+/*-------------------------------------------------------------
+Line solves the small puzzles at 'indexes' together, queuing the
+solutions found to be written out. Those that line solving does
+not finish, or that do not fit in the batch, are handed back to
+the usual path: their hints are dropped from 'small' and a
+nonagram is built for them instead.
+-------------------------------------------------------------*/
+
+void solveLockstep(std::span<result> results, std::span<std::optional<hint_lists>> small,
+                   std::span<nonagram> puzzles, std::span<std::string> keys,
+                   std::span<const std::size_t> indexes, lockstep_batch& batch, output& dest)
+{
+	auto start = std::chrono::steady_clock::now();
+
+	batch.clear();
+	std::vector<std::size_t> lane_of, rest;
+	for (const auto i : indexes)
+	{
+		if (batch.add(small[i]->rows, small[i]->cols))
+			lane_of.push_back(i);
+		else
+			rest.push_back(i);
+	}
+
+	batch.solve();
+
+	// The batch is solved as a whole, so its time is shared out evenly.
+	const double solve_time =
+		seconds(std::chrono::steady_clock::now() - start).count() / std::max(batch.size(), 1u);
+
+	for (unsigned lane = 0; lane < batch.size(); ++lane)
+	{
+		auto& res = results[lane_of[lane]];
+		res.source = result::source_t::lockstep;
+		res.solve_time = solve_time;
+
+		switch (batch.result(lane))
+		{
+		case lockstep_batch::outcome::solved:
+		{
+			auto output_start = std::chrono::steady_clock::now();
+
+			res.status = result::status_t::solved;
+			if (dest.archive)
+			{
+				const unsigned rows = static_cast<unsigned>(small[lane_of[lane]]->rows.size());
+				const unsigned cols = static_cast<unsigned>(small[lane_of[lane]]->cols.size());
+				const auto filled = std::make_unique<bool[]>(rows * cols);
+				for (unsigned pos = 0; pos < rows * cols; ++pos)
+					filled[pos] = batch.isFilled(lane, pos / cols, pos % cols);
+
+				const auto grid = dest.archive->addGrid(rows, cols, {filled.get(), rows * cols});
+				if (grid)
+					dest.archive->addName(res.infile.filename().string(), *grid);
+				else
+					res.status = result::status_t::output_error;
+			}
+			else
+			{
+				auto data = std::make_shared<const std::string>(batch.bitmap(lane).bytes());
+				dest.writer.write(res.outfile, std::move(data));
+			}
+
+			res.output_time = seconds(std::chrono::steady_clock::now() - output_start).count();
+			break;
+		}
+		case lockstep_batch::outcome::stuck:
+			rest.push_back(lane_of[lane]);
+			break;
+		default:
+			break;
+		}
+		res.total_time = res.input_time + res.solve_time + res.output_time;
 	}
 
-	auto solve_done = std::chrono::steady_clock::now();
+	for (const auto i : rest)
+	{
+		results[i].source = result::source_t::search;
+		results[i].solve_time = results[i].output_time = 0;
+
+		puzzles[i] = nonagram(small[i]->rows, small[i]->cols);
+		keys[i] = solution_cache::key(puzzles[i]);
+		small[i].reset();
+	}
+}
 
-	puzzle.bitmap().write(outfile);
+// Writes a path as a quoted string, escaping quotes and backslashes.
+void writeQuoted(std::ostream& out, const stdfs::path& path, char escape)
+{
+	out << '"';
+	for (const char c : path.string())
+	{
+		if (c == '"' || c == '\\')
+			out << (c == '"' ? escape : '\\');
+		out << c;
+	}
+	out << '"';
+}
+
+void writeCsv(std::ostream& out, const std::vector<result>& results, bool rated)
+{
+	out << "input,status,source,input_s,solve_s,output_s,total_s,nodes,output";
+	if (rated)
+		out << ",tier,passes,lines,probes,depth";
+	out << '\n';
+
+	for (const auto& res : results)
+	{
+		writeQuoted(out, res.infile, '"');
+		out << ',' << statusName(res.status) << ',' << sourceName(res.source) << ','
+			<< res.input_time << ',' << res.solve_time << ',' << res.output_time << ','
+			<< res.total_time << ',' << res.nodes << ',';
+		if (res.status == result::status_t::solved)
+			writeQuoted(out, res.outfile, '"');
+		if (rated)
+		{
+			out << ',';
+			if (const auto& r = res.rating)
+			{
+				out << tierName(r->level) << ',' << r->passes << ',' << r->lines << ','
+					<< r->probes << ',' << r->depth;
+			}
+			else
+			{
+				out << ",,,,";
+			}
+		}
+		out << '\n';
+	}
+}
 
-	auto output_done = std::chrono::steady_clock::now();
+void writeJson(std::ostream& out, const std::vector<result>& results, bool rated)
+{
+	out << "[\n";
+	for (std::size_t i = 0; i < results.size(); ++i)
+	{
+		const auto& res = results[i];
 
-	std::lock_guard lock(iomut);
-	std::cout << std::setw(12)
-			  << std::chrono::duration<double, std::milli>(input_done - start).count()
-			  << std::setw(12)
-			  << std::chrono::duration<double, std::ratio<1>>(solve_done - input_done).count()
-			  << std::setw(12)
-			  << std::chrono::duration<double, std::milli>(output_done - solve_done).count()
-			  << std::setw(12)
-			  << std::chrono::duration<double, std::ratio<1>>(output_done - start).count() << infile
-			  << '\n';
+		out << "  {\"input\": ";
+		writeQuoted(out, res.infile, '\\');
+		out << ", \"status\": \"" << statusName(res.status) << "\", \"source\": \""
+			<< sourceName(res.source) << "\", \"input_s\": " << res.input_time
+			<< ", \"solve_s\": " << res.solve_time << ", \"output_s\": " << res.output_time
+			<< ", \"total_s\": " << res.total_time << ", \"nodes\": " << res.nodes
+			<< ", \"output\": ";
+		if (res.status == result::status_t::solved)
+			writeQuoted(out, res.outfile, '\\');
+		else
+			out << "null";
+		if (rated)
+		{
+			out << ", \"rating\": ";
+			if (const auto& r = res.rating)
+			{
+				out << "{\"tier\": \"" << tierName(r->level) << "\", \"passes\": " << r->passes
+					<< ", \"lines\": " << r->lines << ", \"probes\": " << r->probes
+					<< ", \"depth\": " << r->depth << '}';
+			}
+			else
+			{
+				out << "null";
+			}
+		}
+		out << (i + 1 < results.size() ? "},\n" : "}\n");
+	}
+	out << "]\n";
+}
+
+// The first puzzle solved with some hints, and where its solution starts in
+// the archive, if it went there.
+struct first_solved
+{
+	std::size_t index;
+	std::optional<std::uint64_t> grid;
+};
+
+/*-------------------------------------------------------------
+Reads and solves the puzzles of 'results' from 'offset' on, as
+solveFiles() does, at most 'count' of them. Puzzles with the
+same hints as one of an earlier chunk, in 'earlier', are not
+solved again: they are added to the archive under the same grid,
+or added to 'copies', as (index, index of the earlier puzzle),
+for their bitmap to be copied once written.
+-------------------------------------------------------------*/
+
+void solveChunk(std::span<result> all, std::size_t offset, std::size_t count,
+                const options& opts, const std::optional<solution_cache>& cache, output& dest,
+                worker_pool<worker_context>& pool,
+                std::unordered_map<std::string, first_solved>& earlier,
+                std::vector<std::pair<std::size_t, std::size_t>>& copies)
+{
+	const auto results = all.subspan(offset, count);
+	std::vector<nonagram> puzzles(count);
+	std::vector<std::string> keys(count);
+	std::vector<std::optional<hint_lists>> small(count);
+	std::vector<std::optional<color_nonagram>> colored(count);
+
+	for (std::size_t i = 0; i < count; ++i)
+	{
+		auto* hints = opts.lockstep ? &small[i] : nullptr;
+		pool.push([&, i, hints](worker_context& ctx)
+		          { read(results[i], puzzles[i], keys[i], colored[i], hints, ctx.hints); });
+	}
+	pool.wait();
+
+	if (opts.lockstep)
+	{
+		std::vector<std::size_t> indexes;
+		for (std::size_t i = 0; i < count; ++i)
+		{
+			if (small[i])
+				indexes.push_back(i);
+		}
+
+		for (std::size_t first = 0; first < indexes.size(); first += lockstep_batch::lanes)
+		{
+			const auto batch = std::span(indexes).subspan(
+				first, std::min<std::size_t>(lockstep_batch::lanes, indexes.size() - first));
+			pool.push([&, batch](worker_context& ctx)
+			          { solveLockstep(results, small, puzzles, keys, batch, ctx.batch, dest); });
+		}
+		pool.wait();
+	}
+
+	// Group the puzzles by their hints, in input order.
+	std::vector<std::vector<std::size_t>> groups;
+	{
+		std::unordered_map<std::string_view, std::size_t> group_of;
+		for (std::size_t i = 0; i < count; ++i)
+		{
+			auto& res = results[i];
+
+			// Small puzzles still here were settled by line solving alone.
+			if (res.status == result::status_t::input_error ||
+			    res.status == result::status_t::infeasible || small[i])
+				continue;
+
+			if (colored[i])
+			{
+				pool.push([&, i](worker_context&) { solveColor(results[i], *colored[i], dest); });
+				continue;
+			}
+
+			if (const auto it = earlier.find(keys[i]); it != earlier.end())
+			{
+				const auto& prior = all[it->second.index];
+				res.source = result::source_t::duplicate;
+				res.status = prior.status;
+				res.rating = prior.rating;
+				res.total_time = res.input_time;
+
+				if (res.status != result::status_t::solved)
+					continue;
+				if (!dest.archive)
+					copies.emplace_back(offset + i, it->second.index);
+				else if (it->second.grid)
+					dest.archive->addName(res.infile.filename().string(), *it->second.grid);
+				continue;
+			}
+
+			const auto [it, added] = group_of.try_emplace(keys[i], groups.size());
+			if (added)
+				groups.emplace_back();
+			groups[it->second].push_back(i);
+		}
+	}
+
+	// Every worker may be searching at once, so each gets its share of the
+	// hardware threads. Threads a pinned worker starts would share its CPU,
+	// so it searches on its own.
+	const unsigned search_threads =
+		opts.pin ? 1 : std::max(std::thread::hardware_concurrency() / opts.threads, 1u);
+
+	std::vector<std::optional<std::uint64_t>> grids(groups.size());
+	for (std::size_t g = 0; g < groups.size(); ++g)
+	{
+		pool.push(
+			[&, g](worker_context&)
+			{
+				const auto& group = groups[g];
+				auto& puzzle = puzzles[group[0]];
+				puzzle.setMemoryBudget(opts.memory_budget);
+				puzzle.setThreads(search_threads);
+				if (opts.checkpoint != 0)
+				{
+					auto file = opts.outfolder / results[group[0]].infile.filename();
+					puzzle.setCheckpoint({file.replace_extension(".checkpoint"),
+					                      std::chrono::seconds(opts.checkpoint), opts.resume});
+				}
+				grids[g] = solve(results, group, puzzle, keys[group[0]], cache, opts, dest);
+			});
+	}
+	pool.wait();
+
+	for (std::size_t g = 0; g < groups.size(); ++g)
+		earlier.try_emplace(std::move(keys[groups[g][0]]), offset + groups[g][0], grids[g]);
+}
+
+/*-------------------------------------------------------------
+Solves the puzzles in 'infiles' on 'pool', writing out their
+solutions, into 'archive' if given, and returns how each went,
+in the same order. Waits for the solutions to be written, unless
+they went into the archive, which the caller finishes.
+-------------------------------------------------------------*/
+
+std::vector<result> solveFiles(std::span<const stdfs::path> infiles, const options& opts,
+                               const std::optional<solution_cache>& cache,
+                               archive_writer* archive, worker_pool<worker_context>& pool)
+{
+	std::vector<result> results(infiles.size());
+	for (std::size_t i = 0; i < infiles.size(); ++i)
+	{
+		results[i].infile = infiles[i];
+		results[i].outfile = archive ? opts.archive
+		                             : opts.outfolder /
+		                                   infiles[i].filename().replace_extension(".bmp");
+	}
+
+	async_writer writer(opts.output_buffer);
+	output dest{writer, archive};
+
+	// Only so many puzzles are held at once, enough to fill a lockstep batch
+	// for every worker. Only the hints of those already solved are kept, to
+	// tell their duplicates.
+	const std::size_t chunk = std::size_t(opts.threads) * lockstep_batch::lanes;
+	std::unordered_map<std::string, first_solved> earlier;
+	std::vector<std::pair<std::size_t, std::size_t>> copies;
+
+	for (std::size_t offset = 0; offset < infiles.size(); offset += chunk)
+	{
+		solveChunk(results, offset, std::min(chunk, infiles.size() - offset), opts, cache, dest,
+		           pool, earlier, copies);
+	}
+
+	for (const auto& path : writer.finish())
+	{
+		auto& res = *std::ranges::find(results, path, &result::outfile);
+		res.status = result::status_t::output_error;
+	}
+
+	// The bitmaps to copy have all been written by now.
+	for (const auto& [i, prior] : copies)
+	{
+		std::error_code ec;
+		if (results[prior].status != result::status_t::solved ||
+		    !stdfs::copy_file(results[prior].outfile, results[i].outfile,
+		                      stdfs::copy_options::overwrite_existing, ec))
+			results[i].status = result::status_t::output_error;
+	}
+
+	return results;
+}
+
+/*-------------------------------------------------------------
+Claims shards of the queue given with --queue until every one is
+done, solving each as solveFiles() does and recording its report
+in the queue. Adds the results of the shards solved here to
+'results', and writes the report covering every shard. Returns
+false if the queue cannot be used.
+-------------------------------------------------------------*/
+
+bool solveShards(std::span<const stdfs::path> infiles, const options& opts,
+                 const std::optional<solution_cache>& cache, worker_pool<worker_context>& pool,
+                 std::vector<result>& results)
+{
+	// Other hosts may mount the input folder elsewhere.
+	std::vector<std::string> names;
+	for (const auto& infile : infiles)
+		names.push_back(infile.filename().string());
+
+	work_queue queue(opts.queue, std::chrono::seconds(opts.lease));
+	if (!queue.open(names, opts.shard_size))
+	{
+		std::cerr << "Could not use " << opts.queue
+				  << " as a work queue, or it holds a queue for other puzzles.\n";
+		return false;
+	}
+
+	while (const auto shard = queue.claim())
+	{
+		std::vector<stdfs::path> files;
+		for (const auto& name : queue.files(*shard))
+			files.push_back(opts.infolder / name);
+
+		auto done = solveFiles(files, opts, cache, nullptr, pool);
+
+		// If this fails, the lease runs out and the shard is solved again.
+		std::ostringstream report;
+		writeCsv(report, done, opts.rate);
+		if (!queue.complete(*shard, std::move(report).str()))
+			std::cerr << "Could not record the results of shard " << *shard << ".\n";
+
+		std::ranges::move(done, std::back_inserter(results));
+	}
+
+	if (opts.report.empty())
+		return true;
+
+	// Every process writes the same report, each under a name of its own
+	// first. Only the first shard's header line is kept.
+	auto temp = opts.report;
+	temp += '.' + queue.id();
+	{
+		std::ofstream out(temp);
+		bool first = true;
+		for (const auto& shard : queue.results())
+		{
+			const auto header_end = shard.find('\n');
+			if (header_end != std::string::npos)
+				out << (first ? shard : shard.substr(header_end + 1));
+			first = false;
+		}
+
+		out.close();
+		if (!out)
+		{
+			std::cerr << "Could not write the report " << opts.report << ".\n";
+			return true;
+		}
+	}
+
+	std::error_code ec;
+	stdfs::rename(temp, opts.report, ec);
+	if (ec)
+		std::cerr << "Could not write the report " << opts.report << ".\n";
+	return true;
 }
 
 int main(int argc, const char* argv[])
 {
-	parseArgs(argc, argv);
-	stdfs::path infolder(argv[1]), outfolder(argv[2]);
+	const auto run_start = std::chrono::steady_clock::now();
+
+	const auto opts = parseArgs(argc, argv);
 
-	ctpl::thread_pool pool;
+	stdfs::create_directories(opts.outfolder);
 
-	stdfs::create_directories(outfolder);
+	std::optional<solution_cache> cache;
+	if (!opts.cache.empty())
+		cache.emplace(opts.cache);
+
+	std::vector<stdfs::path> infiles;
+	for (const auto& infile : stdfs::directory_iterator(opts.infolder))
+	{
+		if (!infile.is_directory())
+			infiles.push_back(infile.path());
+	}
+	std::ranges::sort(infiles);
+
+	std::optional<archive_writer> archive;
+	if (!opts.archive.empty() && !archive.emplace(opts.archive).good())
+	{
+		std::cerr << "Could not open file " << opts.archive << " for writing.\n";
+		return 1;
+	}
+
+	// One pool for every stage, and every shard, so that workers keep their
+	// contexts throughout.
+	worker_pool<worker_context> pool(opts.threads, opts.pin);
+
+	std::vector<result> results;
+	if (opts.queue.empty())
+		results = solveFiles(infiles, opts, cache, archive ? &*archive : nullptr, pool);
+	else if (!solveShards(infiles, opts, cache, pool, results))
+		return 1;
+
+	// Workers have been available for this long, whether busy or not.
+	const double pool_time = seconds(pool.uptime()).count();
+
+	// Nothing in the archive can be read back without its index.
+	if (archive && !archive->finish())
+	{
+		std::cerr << "Could not write the archive " << opts.archive << ".\n";
+		for (auto& res : results)
+		{
+			if (res.status == result::status_t::solved)
+				res.status = result::status_t::output_error;
+		}
+	}
 
 	std::cout << std::left
 			  << "input (ms)  "
 				 "solve (s)   "
 				 "output (ms) "
 				 "total (s)   "
-				 "input file\n";
-	for (const auto& infile : stdfs::directory_iterator(infolder))
+				 "nodes       "
+			  << (opts.rate ? "tier          " : "") << "input file\n";
+	for (const auto& res : results)
 	{
-		if (infile.is_directory())
+		if (res.status != result::status_t::solved)
+		{
+			std::cout << res.infile << ' ' << statusName(res.status);
+			if (!res.problem.empty())
+				std::cout << ": " << res.problem;
+			std::cout << '\n';
 			continue;
+		}
 
-		auto outfile = outfolder / infile.path().filename().replace_extension(".bmp");
+		std::cout << std::setw(12) << res.input_time * 1000 << std::setw(12) << res.solve_time
+				  << std::setw(12) << res.output_time * 1000 << std::setw(12) << res.total_time
+				  << std::setw(12) << res.nodes;
+		if (res.rating)
+			std::cout << std::setw(14) << tierName(res.rating->level);
+		std::cout << res.infile << '\n';
+	}
+
+	const auto hits = std::ranges::count(results, result::source_t::cache, &result::source);
+	const auto duplicates =
+		std::ranges::count(results, result::source_t::duplicate, &result::source);
+	std::cout << hits << " cache hits, " << duplicates << " duplicates, peak memory "
+			  << (peakMemory() >> 20) << " MB\n";
+
+	const auto solved = std::ranges::count(results, result::status_t::solved, &result::status);
+	const double elapsed = seconds(std::chrono::steady_clock::now() - run_start).count();
+	std::cout << solved << " of " << results.size() << " puzzles solved in " << elapsed << " s, "
+			  << static_cast<double>(solved) / elapsed << " puzzles/s\n";
+
+	if (opts.rate)
+	{
+		std::cout << "Puzzles by tier:";
+		for (const auto level : {nonagram::tier::overlap, nonagram::tier::line_solving,
+		                         nonagram::tier::probing, nonagram::tier::search})
+		{
+			const auto rated = [&](const result& res)
+			{ return res.rating && res.rating->level == level; };
+			const auto count = std::ranges::count_if(results, rated);
+			std::cout << ' ' << count << ' ' << tierName(level)
+					  << (level == nonagram::tier::search ? "\n" : ",");
+		}
+	}
+
+	std::cout << "Worker CPU   tasks     busy (s)    utilization\n";
+	for (std::size_t w = 0; w < pool.stats().size(); ++w)
+	{
+		const auto& worker = *pool.stats()[w];
+		const double busy = seconds(worker.busy).count();
+
+		std::cout << std::setw(7) << w << std::setw(6);
+		if (worker.cpu)
+			std::cout << *worker.cpu;
+		else
+			std::cout << '-';
+		std::cout << std::setw(10) << worker.tasks << std::setw(12) << busy
+				  << 100 * busy / pool_time << "%\n";
+	}
+
+	// With a queue, the report covers every process and is already written.
+	if (!opts.report.empty() && opts.queue.empty())
+	{
+		std::ofstream out(opts.report);
+
+		if (!out.is_open())
+		{
+			std::cerr << "Could not open file " << opts.report << " for writing.\n";
+			return 1;
+		}
 
-		pool.push(solve, infile.path(), outfile);
+		if (opts.report.extension() == ".json")
+			writeJson(out, results, opts.rate);
+		else
+			writeCsv(out, results, opts.rate);
 	}
 }
@@ -1,6 +1,7 @@
 #include "bmp.hpp"
 
 #include <fstream>
+#include <sstream>
 
 BMP_24::BMP_24(unsigned h, unsigned w, color_24 def) : width(w), height(h), grid(w * h, def) {}
 
@@ -24,6 +25,13 @@ void BMP_24::write(const std::string& filename) const
 	std::ofstream(filename, std::ios_base::binary) << *this;
 }
 
+std::string BMP_24::bytes() const
+{
+	std::ostringstream out(std::ios_base::binary);
+	out << *this;
+	return std::move(out).str();
+}
+
 std::ostream& operator<<(std::ostream& out, const BMP_24& bmp)
 {
 	// ID field ("BM") // Must be used
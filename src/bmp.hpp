@@ -2,6 +2,7 @@
 
 #include <cstdint>
 #include <ostream>
+#include <string>
 #include <vector>
 
 /*-----------------------------------------
@@ -64,4 +65,7 @@ class BMP_24
 	friend std::ostream& operator<<(std::ostream& out, const BMP_24& bmp);
 
 	void write(const std::string& filename) const;
+
+	// The contents of the file write() would produce.
+	std::string bytes() const;
 };
@@ -0,0 +1,176 @@
+#pragma once
+
+/*
+A set of candidate starting positions for a fill, all within the range given
+on construction. Stored as one bit per position, rather than one integer, so
+that lines of very large puzzles with many hints stay small, and so that
+removing a range of positions does not need to visit each one.
+
+The smallest and largest positions left are cached, as they are what line
+solving looks at most. No bit outside of them is ever set.
+*/
+
+#include <algorithm>
+#include <bit>
+#include <concepts>
+#include <cstdint>
+#include <vector>
+
+template <std::unsigned_integral T = unsigned>
+class candidate_set
+{
+	using word = std::uint64_t;
+	constexpr static T word_bits = 64;
+
+	// Bit i is position first + i.
+	T first, low, high;
+	std::vector<word> words;
+
+	// The smallest position in [from, high], or high + 1 if there is none.
+	[[nodiscard]] T nextFrom(T from) const noexcept
+	{
+		for (T i = from - first; i <= high - first;)
+		{
+			const word bits = words[i / word_bits] >> (i % word_bits);
+			if (bits)
+				return first + i + static_cast<T>(std::countr_zero(bits));
+			i = (i / word_bits + 1) * word_bits;
+		}
+		return high + 1;
+	}
+
+	// The largest position in [low, before), or low - 1 if there is none.
+	[[nodiscard]] T prevBefore(T before) const noexcept
+	{
+		for (T i = before - first; i > low - first;)
+		{
+			const T shift = word_bits - 1 - (i - 1) % word_bits;
+			const word bits = words[(i - 1) / word_bits] << shift;
+			if (bits)
+				return first + i - 1 - static_cast<T>(std::countl_zero(bits));
+			i = (i - 1) / word_bits * word_bits;
+		}
+		return low - 1;
+	}
+
+	void clear(T pos) noexcept
+	{
+		words[(pos - first) / word_bits] &= ~(word(1) << ((pos - first) % word_bits));
+	}
+
+	void makeEmpty() noexcept
+	{
+		low = first + 1;
+		high = first;
+	}
+
+  public:
+	// Every position from start to end, inclusive.
+	candidate_set(T start, T end)
+		: first(start), low(start), high(end), words((end - start) / word_bits + 1, ~word(0))
+	{
+		// Positions past the end are never set.
+		words.back() >>= word_bits - 1 - (end - start) % word_bits;
+	}
+
+	[[nodiscard]] bool empty() const noexcept { return low > high; }
+	[[nodiscard]] T front() const noexcept { return low; }
+	[[nodiscard]] T back() const noexcept { return high; }
+
+	// The smallest position at or after pos, or back() + 1 if there is none.
+	[[nodiscard]] T next(T pos) const noexcept
+	{
+		if (pos <= low)
+			return low;
+		return (pos > high) ? high + 1 : nextFrom(pos);
+	}
+
+	[[nodiscard]] bool contains(T pos) const noexcept
+	{
+		return low <= pos && pos <= high &&
+		       ((words[(pos - first) / word_bits] >> ((pos - first) % word_bits)) & 1);
+	}
+
+	void pop_front() noexcept
+	{
+		clear(low);
+		if (low == high)
+			makeEmpty();
+		else
+			low = nextFrom(low + 1);
+	}
+
+	void pop_back() noexcept
+	{
+		clear(high);
+		if (low == high)
+			makeEmpty();
+		else
+			high = prevBefore(high);
+	}
+
+	// Removes every position in [start, end).
+	void erase(T start, T end) noexcept
+	{
+		if (start < low)
+			start = low;
+		if (end > high + 1)
+			end = high + 1;
+		if (start >= end)
+			return;
+
+		if (start == low && end == high + 1)
+		{
+			makeEmpty();
+			return;
+		}
+
+		for (T pos = start; pos < end;)
+		{
+			const T i = pos - first, bit = i % word_bits;
+			const T count = std::min<T>(word_bits - bit, end - pos);
+			const word mask = (count == word_bits) ? ~word(0) : ((word(1) << count) - 1) << bit;
+
+			words[i / word_bits] &= ~mask;
+			pos += count;
+		}
+
+		if (start == low)
+			low = nextFrom(end);
+		else if (end == high + 1)
+			high = prevBefore(start);
+	}
+
+	void erase(T pos) noexcept { erase(pos, pos + 1); }
+
+	// Heap memory held, in bytes.
+	[[nodiscard]] std::size_t memoryUsage() const noexcept
+	{
+		return words.capacity() * sizeof(word);
+	}
+
+	class iterator
+	{
+		const candidate_set* set;
+		T pos;
+
+	  public:
+		iterator(const candidate_set* s, T p) noexcept : set(s), pos(p) {}
+
+		iterator& operator++() noexcept
+		{
+			pos = set->nextFrom(pos + 1);
+			return *this;
+		}
+
+		[[nodiscard]] bool operator==(const iterator& other) const noexcept
+		{
+			return pos == other.pos;
+		}
+
+		[[nodiscard]] T operator*() const noexcept { return pos; }
+	};
+
+	[[nodiscard]] iterator begin() const noexcept { return iterator(this, low); }
+	[[nodiscard]] iterator end() const noexcept { return iterator(this, high + 1); }
+};
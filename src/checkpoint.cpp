@@ -0,0 +1,169 @@
+#include "checkpoint.hpp"
+
+#include <fstream>
+#include <string>
+#include <system_error>
+
+#include <unistd.h>
+
+namespace stdfs = std::filesystem;
+
+namespace
+{
+constexpr const char* header = "nonagram-checkpoint 1";
+
+std::ostream& operator<<(std::ostream& stream, const checkpoint::literal& lit)
+{
+	return stream << lit.pos << ' ' << lit.filled;
+}
+
+std::istream& operator>>(std::istream& stream, checkpoint::literal& lit)
+{
+	return stream >> lit.pos >> lit.filled;
+}
+
+// Reads a count followed by that many items. The count is not trusted to size
+// anything before the items are actually there.
+template <typename T, typename Read>
+bool readList(std::istream& stream, std::vector<T>& items, Read&& read)
+{
+	std::size_t count;
+	if (!(stream >> count))
+		return false;
+
+	items.clear();
+	for (; count > 0; --count)
+	{
+		T item{};
+		if (!read(stream, item))
+			return false;
+		items.push_back(std::move(item));
+	}
+	return true;
+}
+
+bool readValue(std::istream& stream, auto& value)
+{
+	return !!(stream >> value);
+}
+
+bool readLiterals(std::istream& stream, std::vector<checkpoint::literal>& literals)
+{
+	return readList(stream, literals, readValue<checkpoint::literal>);
+}
+
+bool readHintList(std::istream& stream, std::vector<unsigned>& list)
+{
+	return readList(stream, list, readValue<unsigned>);
+}
+
+bool readStep(std::istream& stream, checkpoint::step& s)
+{
+	return !!(stream >> s.cell >> s.guess >> s.reason);
+}
+
+bool readPart(std::istream& stream, checkpoint::part& p)
+{
+	if (!(stream >> p.size >> p.nodes >> p.solved))
+		return false;
+
+	if (!p.solved)
+		return readList(stream, p.path, readStep) && readList(stream, p.nogoods, readLiterals);
+
+	// Prefixed so that a part with no cells still has a word to read.
+	std::string cells;
+	if (!(stream >> cells) || cells.size() != p.size + 1 || cells[0] != 'c')
+		return false;
+
+	for (const char c : cells.substr(1))
+		p.filled.push_back(c == '1');
+	return true;
+}
+} // namespace
+
+bool checkpoint::read(const stdfs::path& file)
+{
+	std::ifstream ifs(file);
+	std::string line;
+	if (!std::getline(ifs, line) || line != header)
+		return false;
+
+	return (ifs >> rows) && readList(ifs, hints, readHintList) && readList(ifs, parts, readPart);
+}
+
+bool checkpoint::write(const stdfs::path& file) const
+{
+	// Write to a temporary file first, so that the last checkpoint stays whole
+	// until the new one is. It is named after the host and process, as a
+	// process taking over a shard of a work queue may write the same
+	// checkpoint as the one it took it from.
+	char host[256] = {};
+	gethostname(host, sizeof(host) - 1);
+	auto temp = file;
+	temp += '.' + std::string(host) + '.' + std::to_string(getpid()) + ".tmp";
+	{
+		std::ofstream ofs(temp);
+		ofs << header << '\n' << rows << ' ' << hints.size() << '\n';
+		for (const auto& list : hints)
+		{
+			ofs << list.size();
+			for (const auto hint : list)
+				ofs << ' ' << hint;
+			ofs << '\n';
+		}
+
+		ofs << parts.size() << '\n';
+		for (const auto& p : parts)
+		{
+			ofs << p.size << ' ' << p.nodes << ' ' << p.solved << '\n';
+			if (p.solved)
+			{
+				ofs << 'c';
+				for (const char filled : p.filled)
+					ofs << (filled ? '1' : '0');
+				ofs << '\n';
+				continue;
+			}
+
+			ofs << p.path.size() << '\n';
+			for (const auto& s : p.path)
+				ofs << s.cell << ' ' << s.guess << ' ' << s.reason << '\n';
+
+			ofs << p.nogoods.size() << '\n';
+			for (const auto& ng : p.nogoods)
+			{
+				ofs << ng.size();
+				for (const auto& lit : ng)
+					ofs << ' ' << lit;
+				ofs << '\n';
+			}
+		}
+
+		ofs.close();
+		if (!ofs)
+		{
+			std::error_code ec;
+			stdfs::remove(temp, ec);
+			return false;
+		}
+	}
+
+	std::error_code ec;
+	stdfs::rename(temp, file, ec);
+	return !ec;
+}
+
+void checkpoint_writer::update(unsigned which, checkpoint::part progress, bool now)
+{
+	std::lock_guard lock(mut);
+	progress.size = saved.parts[which].size;
+	saved.parts[which] = std::move(progress);
+
+	const auto time = clock::now();
+	if (!now && time - last_write < interval)
+		return;
+
+	last_write = time;
+	if (!saved.write(file))
+		failed = true;
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+/*
+The progress of nonagram::solve(), saved to disk so that a search stopped part
+way, by a restart or a killed process, can pick up where it was instead of
+starting over. See nonagram::setCheckpoint().
+
+Line solving always deduces the same from the same cells, so rather than the
+grid and the candidates of each line, a checkpoint holds what cannot be worked
+out again cheaply. For each part of the grid searched on its own: the branch
+being searched, as the guesses made along it and the values taken after a
+guess was refuted, each with the guesses its refutation depended on; and the
+nogoods learned so far. Parts already solved are saved as their cells.
+
+The file is text, and is replaced whole through a temporary file so that a
+process stopped while writing leaves the previous checkpoint in place.
+*/
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <vector>
+
+struct checkpoint
+{
+	struct literal
+	{
+		unsigned pos;
+		bool filled;
+	};
+
+	// A guess, or the other value of a cell after its guess was refuted.
+	struct step
+	{
+		literal cell;
+		bool guess;
+		// The search levels the refutation depended on, for other values.
+		std::uint64_t reason;
+	};
+
+	struct part
+	{
+		// Unknown cells in the part, as a check that it is the same one.
+		unsigned size = 0;
+		std::uint64_t nodes = 0;
+
+		// Once solved, the values of its cells in row-major order.
+		bool solved = false;
+		std::vector<char> filled;
+
+		std::vector<step> path;
+		std::vector<std::vector<literal>> nogoods;
+	};
+
+	// Identifies the puzzle: rows, then the hint lists of every line.
+	unsigned rows = 0;
+	std::vector<std::vector<unsigned>> hints;
+
+	std::vector<part> parts;
+
+	// Returns false if the file cannot be read or is not a checkpoint.
+	[[nodiscard]] bool read(const std::filesystem::path& file);
+	[[nodiscard]] bool write(const std::filesystem::path& file) const;
+};
+
+// Where and how often solve() saves its progress, and whether it first picks
+// up from a checkpoint already there.
+struct checkpoint_settings
+{
+	std::filesystem::path file;
+	std::chrono::seconds interval{60};
+	bool resume = false;
+};
+
+/*
+Keeps the latest progress reported for each part of one solve(), and writes
+them all out at most once per interval. Parts may be searched, and so report,
+on several threads at once.
+*/
+
+class checkpoint_writer
+{
+	using clock = std::chrono::steady_clock;
+
+	std::mutex mut;
+	std::filesystem::path file;
+	clock::duration interval;
+	clock::time_point last_write = clock::now();
+	checkpoint saved;
+	bool failed = false;
+
+  public:
+	checkpoint_writer(const checkpoint_settings& settings, checkpoint start)
+		: file(settings.file), interval(settings.interval), saved(std::move(start))
+	{
+	}
+
+	clock::duration saveInterval() const { return interval; }
+
+	// Replaces the progress of one part, writing the file if it is due or if
+	// 'now' is set.
+	void update(unsigned which, checkpoint::part progress, bool now = false);
+
+	// Whether writing the file has failed at any point.
+	bool writeFailed()
+	{
+		std::lock_guard lock(mut);
+		return failed;
+	}
+};
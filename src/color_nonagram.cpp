@@ -0,0 +1,396 @@
+#include "color_nonagram.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cctype>
+#include <cstdint>
+#include <sstream>
+#include <string>
+
+bool isColorFormat(std::istream& stream)
+{
+	const auto start = stream.tellg();
+
+	std::string header;
+	std::getline(stream, header);
+
+	stream.clear();
+	stream.seekg(start);
+
+	std::istringstream values(header);
+	unsigned numcols, numrows, numcolors;
+	return static_cast<bool>(values >> numcols >> numrows >> numcolors);
+}
+
+/*-------------------------------------------------
+Reads a palette entry, either a color name from
+color_24_consts or three numbers, red green blue.
+-------------------------------------------------*/
+
+static bool getColor(std::istream& in, color_24& color)
+{
+	using namespace color_24_consts;
+
+	constexpr std::pair<const char*, color_24> names[] = {
+		{"white", white},
+		{"light_gray", light_gray},
+		{"gray", gray},
+		{"dark_gray", dark_gray},
+		{"black", black},
+		{"blue", blue},
+		{"green", green},
+		{"red", red},
+		{"yellow", yellow},
+		{"pink", pink},
+		{"light_blue", light_blue},
+		{"light_green", light_green},
+		{"orange", orange},
+		{"light_brown", light_brown},
+		{"magenta", magenta},
+	};
+
+	in >> std::ws;
+	if (std::isdigit(in.peek()))
+	{
+		unsigned r, g, b;
+		in >> r >> g >> b;
+		color = {static_cast<std::uint8_t>(b), static_cast<std::uint8_t>(g),
+		         static_cast<std::uint8_t>(r)};
+		return static_cast<bool>(in);
+	}
+
+	std::string name;
+	in >> name;
+	for (const auto& [n, c] : names)
+	{
+		if (name == n)
+		{
+			color = c;
+			return true;
+		}
+	}
+	return false;
+}
+
+/*-------------------------------------------------------
+Reads one line of colored hints from in, such as 2a 1b 3a.
+A lone 0 is an empty line. Returns false on a bad color.
+-------------------------------------------------------*/
+
+static bool getList(std::istream& in, std::vector<unsigned>& lengths,
+                    std::vector<unsigned>& colors, unsigned numcolors)
+{
+	in >> std::ws;
+
+	// Stopping at end of file keeps a missing newline after the last line
+	// from setting failbit.
+	for (int c; in.good() && (c = in.peek()) != '\n' && c != std::char_traits<char>::eof();)
+	{
+		if ('0' <= c && c <= '9')
+		{
+			unsigned length;
+			in >> length;
+
+			if (length == 0)
+				continue;
+
+			const int letter = in.get();
+			if (letter < 'a' || 'a' + static_cast<int>(numcolors) <= letter)
+				return false;
+
+			lengths.push_back(length);
+			colors.push_back(static_cast<unsigned>(letter - 'a') + 1);
+		}
+		else
+		{
+			in.ignore();
+		}
+	}
+	return true;
+}
+
+std::istream& operator>>(std::istream& stream, color_nonagram& CP)
+{
+	unsigned numcolors;
+	stream >> CP.numcols >> CP.numrows >> numcolors;
+
+	// Cell indexes, and one past the end of each line, must fit in an unsigned.
+	if (!stream || numcolors > color_nonagram::max_colors ||
+	    (std::uint64_t(CP.numrows) + 1) * (std::uint64_t(CP.numcols) + 1) > ~0u)
+	{
+		stream.setstate(std::ios_base::failbit);
+		return stream;
+	}
+
+	CP.palette.resize(numcolors + 1);
+	CP.palette[0] = color_24_consts::white;
+	for (unsigned c = 1; c <= numcolors; ++c)
+	{
+		if (!getColor(stream, CP.palette[c]))
+		{
+			stream.setstate(std::ios_base::failbit);
+			return stream;
+		}
+	}
+
+	// Every cell starts out able to take any color.
+	const color_nonagram::color_set all = (color_nonagram::color_set(2) << numcolors) - 1;
+	CP.grid.assign(CP.numrows * CP.numcols, all);
+
+	CP.lines.assign(CP.numrows + CP.numcols, {});
+
+	std::vector<unsigned> lengths, colors;
+	for (auto& lin : CP.lines)
+	{
+		lengths.clear();
+		colors.clear();
+
+		if (!getList(stream, lengths, colors, numcolors))
+		{
+			stream.setstate(std::ios_base::failbit);
+			return stream;
+		}
+
+		for (unsigned i = 0; i < lengths.size(); ++i)
+			lin.hints.push_back({lengths[i], colors[i]});
+	}
+
+	return stream;
+}
+
+index_generator<> color_nonagram::lineCells(unsigned lin) const
+{
+	return lin < numrows ? index_generator(numcols * lin, 1u, numcols)
+	                     : index_generator(lin - numrows, numcols, numrows);
+}
+
+/*--------------------------------------------------------------------
+Narrows the candidate colors of every cell in a line down to those used
+by at least one placement of its hints. Hints are placed left to right,
+with a gap between consecutive hints only if they share a color.
+
+This works by dynamic programming over (hint, cell) in both directions:
+  free[j][i]:  cells before i can hold the first j hints, the last cell
+               (if any) being background.
+  ended[j][i]: cells before i can hold the first j hints, hint j - 1
+               ending right before cell i.
+and likewise, mirrored, for the cells from i onwards holding hints j
+and up. A hint can then go at a given start if the cells before and
+after it can hold the rest. Returns false if no placement exists.
+--------------------------------------------------------------------*/
+
+bool color_nonagram::solveLine(unsigned lin)
+{
+	const auto cells = lineCells(lin);
+	const auto& hints = lines[lin].hints;
+	const unsigned n = cells.size();
+	const auto k = static_cast<unsigned>(hints.size());
+
+	const auto at = [n](unsigned j, unsigned i) { return j * (n + 1) + i; };
+
+	const auto canBe = [&](unsigned i, unsigned color)
+	{ return (grid[cells[i]] >> color) & 1; };
+
+	// blocked[c][i] is the number of cells before i that cannot be color c.
+	const auto numcolors = static_cast<unsigned>(palette.size());
+	std::vector<std::vector<unsigned>> blocked(numcolors, std::vector<unsigned>(n + 1, 0));
+	for (unsigned c = 0; c < numcolors; ++c)
+	{
+		for (unsigned i = 0; i < n; ++i)
+			blocked[c][i + 1] = blocked[c][i] + !canBe(i, c);
+	}
+
+	const auto fits = [&](unsigned j, unsigned start)
+	{
+		const unsigned end = start + hints[j].length;
+		return end <= n && blocked[hints[j].color][end] == blocked[hints[j].color][start];
+	};
+
+	// Whether hint j may directly follow hint j - 1.
+	const auto touches = [&](unsigned j)
+	{ return j == 0 || j == k || hints[j - 1].color != hints[j].color; };
+
+	std::vector<char> pre_free((k + 1) * (n + 1), false), pre_ended((k + 1) * (n + 1), false);
+	std::vector<char> suf_free((k + 1) * (n + 1), false), suf_ended((k + 1) * (n + 1), false);
+
+	pre_free[at(0, 0)] = true;
+	for (unsigned i = 0; i <= n; ++i)
+	{
+		for (unsigned j = 0; j <= k; ++j)
+		{
+			const bool here = pre_free[at(j, i)] || pre_ended[at(j, i)];
+
+			if (i < n && here && canBe(i, 0))
+				pre_free[at(j, i + 1)] = true;
+
+			if (j < k && (pre_free[at(j, i)] || (pre_ended[at(j, i)] && touches(j))) &&
+			    fits(j, i))
+			{
+				pre_ended[at(j + 1, i + hints[j].length)] = true;
+			}
+		}
+	}
+
+	if (!pre_free[at(k, n)] && !pre_ended[at(k, n)])
+		return false;
+
+	// Mirrored: suf_ended[j][i] means hint j starts at cell i.
+	suf_free[at(k, n)] = true;
+	for (unsigned i = n + 1; i-- > 0;)
+	{
+		for (unsigned j = k + 1; j-- > 0;)
+		{
+			if (i < n && canBe(i, 0) && (suf_free[at(j, i + 1)] || suf_ended[at(j, i + 1)]))
+				suf_free[at(j, i)] = true;
+
+			if (j < k && fits(j, i))
+			{
+				const unsigned end = i + hints[j].length;
+				if (suf_free[at(j + 1, end)] || (suf_ended[at(j + 1, end)] && touches(j + 1)))
+					suf_ended[at(j, i)] = true;
+			}
+		}
+	}
+
+	// Collect the colors each cell can take. Hint placements are marked with
+	// a difference array per hint, to keep this linear in the line length.
+	std::vector<color_set> possible(n, 0);
+	std::vector<int> covered(n + 1);
+
+	for (unsigned j = 0; j < k; ++j)
+	{
+		std::ranges::fill(covered, 0);
+		for (unsigned i = 0; i + hints[j].length <= n; ++i)
+		{
+			if ((pre_free[at(j, i)] || (pre_ended[at(j, i)] && touches(j))) &&
+			    suf_ended[at(j, i)])
+			{
+				++covered[i];
+				--covered[i + hints[j].length];
+			}
+		}
+
+		int running = 0;
+		for (unsigned i = 0; i < n; ++i)
+		{
+			running += covered[i];
+			if (running > 0)
+				possible[i] |= color_set(1) << hints[j].color;
+		}
+	}
+
+	for (unsigned i = 0; i < n; ++i)
+	{
+		for (unsigned j = 0; j <= k; ++j)
+		{
+			if ((pre_free[at(j, i)] || pre_ended[at(j, i)]) &&
+			    (suf_free[at(j, i + 1)] || suf_ended[at(j, i + 1)]) && canBe(i, 0))
+			{
+				possible[i] |= 1;
+				break;
+			}
+		}
+	}
+
+	// Apply what was learned, flagging the crossing lines of changed cells.
+	for (unsigned i = 0; i < n; ++i)
+	{
+		const unsigned ref = cells[i];
+		const color_set narrowed = grid[ref] & possible[i];
+
+		if (narrowed == 0)
+			return false;
+
+		if (narrowed != grid[ref])
+		{
+			grid[ref] = narrowed;
+			lines[lin < numrows ? numrows + ref % numcols : ref / numcols].needs_line_solving =
+				true;
+		}
+	}
+	return true;
+}
+
+/*-------------------------------------------------------------
+Calls solveLine() on each line needing it until nothing changes.
+Returns false if any line is unsolvable.
+-------------------------------------------------------------*/
+
+bool color_nonagram::line_solve()
+{
+	for (bool changed = true; changed;)
+	{
+		changed = false;
+		for (unsigned i = 0; i < lines.size(); ++i)
+		{
+			if (!lines[i].needs_line_solving)
+				continue;
+
+			lines[i].needs_line_solving = false;
+			changed = true;
+
+			if (!solveLine(i))
+				return false;
+		}
+	}
+	return true;
+}
+
+bool color_nonagram::isComplete() const
+{
+	return std::ranges::all_of(grid, [](color_set cs) { return std::has_single_bit(cs); });
+}
+
+bool color_nonagram::solve()
+{
+	if (!line_solve())
+		return false;
+
+	// find position to brute force
+	const auto undecided =
+		std::ranges::find_if(grid, [](color_set cs) { return !std::has_single_bit(cs); });
+
+	if (undecided == grid.end())
+		return true;
+
+	const auto pos = static_cast<unsigned>(undecided - grid.begin());
+	const color_set candidates = grid[pos];
+
+	// Try each candidate color in turn.
+	for (color_set rest = candidates; rest != 0; rest &= rest - 1)
+	{
+		color_nonagram copy(*this);
+
+		copy.grid[pos] = color_set(1) << std::countr_zero(rest);
+		copy.lines[pos / numcols].needs_line_solving = true;
+		copy.lines[numrows + pos % numcols].needs_line_solving = true;
+
+		if (copy.solve())
+		{
+			std::swap(copy, *this);
+			return true;
+		}
+	}
+	return false;
+}
+
+BMP_24 color_nonagram::bitmap() const
+{
+	BMP_24 soln(numrows, numcols);
+
+	unsigned pos = 0;
+	for (unsigned i = 0; i < numrows; ++i)
+	{
+		// The rows in a bitmap are flipped, so when writing,
+		// write to the opposite side.
+		unsigned rowNum = numrows - 1 - i;
+		for (unsigned j = 0; j < numcols; ++j)
+		{
+			const color_set cs = grid[pos];
+			soln(rowNum, j) = std::has_single_bit(cs) ? palette[std::countr_zero(cs)]
+			                                          : color_24_consts::gray;
+			++pos;
+		}
+	}
+	return soln;
+}
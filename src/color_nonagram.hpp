@@ -0,0 +1,90 @@
+#pragma once
+
+/*
+Format for a colored puzzle, which differs from the black and white format by
+the number of colors on the first line:
+
+#columns #rows #colors
+
+color a (a name from color_24_consts, or R G B)
+color b
+.
+.
+.
+
+row 1 clues (left to right), each a length followed by a color letter, e.g. 2a 1b 3a
+row 2 clues
+.
+.
+.
+
+column 1 clues (top to bottom)
+.
+.
+.
+
+Fills of different colors may touch, fills of the same color need a gap.
+*/
+
+#include "bmp.hpp"
+#include "index_generator.hpp"
+
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+// Returns true if the stream holds a colored puzzle. Leaves the stream at
+// the position it was found.
+bool isColorFormat(std::istream& stream);
+
+class color_nonagram
+{
+	// Bit 0 is the background, bit c is color c of the palette (from 1).
+	using color_set = std::uint32_t;
+	constexpr static unsigned max_colors = 31;
+
+	struct hint
+	{
+		unsigned length, color;
+	};
+
+	struct line
+	{
+		std::vector<hint> hints;
+		bool needs_line_solving = true;
+	};
+
+	// Variables
+	unsigned numrows, numcols;
+
+	std::vector<color_24> palette;
+
+	// Layout of indexes:
+	// Row 0: 0 -> (numcols-1)
+	// Row 1: numcols -> (2*numcols-1)
+	// ...
+	std::vector<color_set> grid;
+
+	// Rows, then columns
+	std::vector<line> lines;
+
+	// Methods related to solving
+	index_generator<> lineCells(unsigned lin) const;
+
+	[[nodiscard]] bool solveLine(unsigned lin);
+	[[nodiscard]] bool line_solve();
+
+  public:
+	// Reads in a colored nonagram puzzle from an input stream.
+	friend std::istream& operator>>(std::istream& stream, color_nonagram& CP);
+
+	// Solves the puzzle, or returns false if unsolvable.
+	[[nodiscard]] bool solve();
+
+	// Returns true if the puzzle is solved.
+	bool isComplete() const;
+
+	// Creates a bitmap of the solution to this puzzle, background in white.
+	// Cells with more than one candidate color left are rendered gray.
+	BMP_24 bitmap() const;
+};
@@ -0,0 +1,68 @@
+#include "cpu_topology.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <string>
+#include <tuple>
+
+#include <pthread.h>
+#include <sched.h>
+
+namespace
+{
+// A topology value of a CPU, or -1 if sysfs does not have it.
+int topologyValue(unsigned cpu, const char* name)
+{
+	std::ifstream in("/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/topology/" + name);
+	int value;
+	return (in >> value) ? value : -1;
+}
+} // namespace
+
+std::vector<unsigned> spreadCpus()
+{
+	cpu_set_t allowed;
+	CPU_ZERO(&allowed);
+	if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+		return {};
+
+	// Number the cores of each socket, and the hardware threads of each core,
+	// in the order their CPUs come.
+	std::map<int, std::map<int, unsigned>> threads_of;
+	std::map<int, std::map<int, unsigned>> core_index;
+
+	// Sorted by thread within its core, then core within its socket, then
+	// socket.
+	std::vector<std::tuple<unsigned, unsigned, int, unsigned>> order;
+	for (unsigned cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+	{
+		if (!CPU_ISSET(cpu, &allowed))
+			continue;
+
+		const int socket = topologyValue(cpu, "physical_package_id");
+		const int core = topologyValue(cpu, "core_id");
+
+		auto& cores = core_index[socket];
+		const auto [it, added] = cores.try_emplace(core, static_cast<unsigned>(cores.size()));
+
+		// Without sysfs, every CPU counts as a core of its own.
+		const unsigned thread = (core < 0) ? 0 : threads_of[socket][core]++;
+		const unsigned index = (core < 0) ? cpu : it->second;
+		order.emplace_back(thread, index, socket, cpu);
+	}
+	std::ranges::sort(order);
+
+	std::vector<unsigned> cpus;
+	for (const auto& entry : order)
+		cpus.push_back(std::get<3>(entry));
+	return cpus;
+}
+
+bool pinToCpu(unsigned cpu)
+{
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+/*
+Which CPUs the process may run on, and in what order to hand them out to
+worker threads pinned one to a CPU. Linux only, going by sysfs.
+*/
+
+#include <vector>
+
+// The CPUs the process may run on, ordered so that the first few workers
+// each get a core of their own, alternating between sockets so that they
+// also share memory bandwidth evenly. Second hardware threads of a core come
+// after every core has one worker.
+std::vector<unsigned> spreadCpus();
+
+// Pins the calling thread to one CPU. Returns false if that is not allowed.
+bool pinToCpu(unsigned cpu);
@@ -0,0 +1,94 @@
+#include "line_table.hpp"
+
+#include <algorithm>
+#include <utility>
+
+// The hint list matching an arrangement, packed so that comparing packed
+// lists compares them lexicographically: 5 bits per hint, first hint highest,
+// and nothing, which is lower than any hint, after the last. Lines of up to
+// 20 cells have at most 10 hints, which fit.
+static std::uint64_t packedHints(line_table::mask arrangement, unsigned cells)
+{
+	std::uint64_t packed = 0;
+	unsigned run = 0, count = 0;
+	for (unsigned i = 0; i <= cells; ++i)
+	{
+		if (i < cells && ((arrangement >> i) & 1))
+		{
+			++run;
+		}
+		else if (run != 0)
+		{
+			packed |= std::uint64_t(run) << (5 * (9 - count++));
+			run = 0;
+		}
+	}
+	return packed;
+}
+
+void line_table::build(length_table& table, unsigned cells)
+{
+	std::vector<std::pair<std::uint64_t, mask>> order(std::size_t(1) << cells);
+	for (mask m = 0; m < order.size(); ++m)
+		order[m] = {packedHints(m, cells), m};
+
+	// Arrangements with the same hints stay in increasing order.
+	std::ranges::sort(order);
+
+	table.masks.resize(order.size());
+	table.group_of.resize(order.size());
+	for (std::uint32_t i = 0; i < order.size(); ++i)
+	{
+		if (i == 0 || order[i].first != order[i - 1].first)
+			table.starts.push_back(i);
+		table.masks[i] = order[i].second;
+		table.group_of[order[i].second] = static_cast<std::uint32_t>(table.starts.size() - 1);
+	}
+	table.starts.push_back(static_cast<std::uint32_t>(order.size()));
+	table.built = true;
+}
+
+const line_table& line_table::get()
+{
+	static const line_table table;
+	return table;
+}
+
+std::span<const line_table::mask> line_table::arrangements(unsigned cells,
+                                                            std::span<const unsigned> hints) const
+{
+	if (cells == 0 || cells > max_cells)
+		return {};
+
+	auto& table = lengths[cells];
+	std::call_once(table.once, build, table, cells);
+
+	// Place every fill as far left as it goes.
+	mask leftmost = 0;
+	unsigned pos = 0;
+	for (const auto hint : hints)
+	{
+		if (hint == 0 || hint > cells || pos > cells - hint)
+			return {};
+
+		leftmost |= ((mask(1) << hint) - 1) << pos;
+		pos += hint + 1;
+	}
+
+	const auto group = table.group_of[leftmost];
+	return std::span(table.masks).subspan(table.starts[group],
+	                                      table.starts[group + 1] - table.starts[group]);
+}
+
+std::size_t line_table::memoryUsage()
+{
+	std::size_t bytes = 0;
+	for (const auto& table : get().lengths)
+	{
+		if (!table.built)
+			continue;
+		bytes += table.masks.capacity() * sizeof(mask) +
+		         (table.starts.capacity() + table.group_of.capacity()) * sizeof(std::uint32_t);
+	}
+	return bytes;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+/*
+Every way of filling in a line of up to max_cells cells, grouped by the hint
+list each one matches. Short lines are solved exactly by checking each of
+their arrangements against the cells already known, instead of by the rules
+the general line solver uses. An arrangement is a bit mask, bit i being set
+if cell i is filled.
+
+max_cells is set by defining CPUZZLE_SHORT_LINE_CELLS, 15 by default and at
+most 20, 0 turning the table off. Each length's part of the table is built
+the first time a line of that length is looked up, and takes about
+8 * 2^length bytes, so about 16 * 2^max_cells bytes once every length is.
+*/
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <span>
+#include <vector>
+
+#ifndef CPUZZLE_SHORT_LINE_CELLS
+#define CPUZZLE_SHORT_LINE_CELLS 15
+#endif
+
+class line_table
+{
+  public:
+	using mask = std::uint32_t;
+	constexpr static unsigned max_cells = CPUZZLE_SHORT_LINE_CELLS;
+	static_assert(max_cells <= 20, "the table would take too long to build");
+
+  private:
+	// The arrangements of lines of one length, sorted by hint list, the
+	// index at which each hint list's arrangements start, and the hint list
+	// of each arrangement, as an index into 'starts'. A hint list is looked
+	// up by the arrangement with every fill as far left as it goes.
+	struct length_table
+	{
+		std::vector<mask> masks;
+		std::vector<std::uint32_t> starts, group_of;
+
+		std::once_flag once;
+		std::atomic<bool> built = false;
+	};
+	mutable std::array<length_table, max_cells + 1> lengths;
+
+	line_table() = default;
+
+	static void build(length_table& table, unsigned cells);
+
+  public:
+	static const line_table& get();
+
+	// The arrangements of a line of 'cells' cells with the given hints, none
+	// of which may be 0. Empty if there are none, or the line is too long.
+	std::span<const mask> arrangements(unsigned cells, std::span<const unsigned> hints) const;
+
+	// Memory held by the parts of the table built so far, in bytes.
+	static std::size_t memoryUsage();
+};
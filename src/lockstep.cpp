@@ -0,0 +1,170 @@
+#include "lockstep.hpp"
+
+#include <algorithm>
+#include <bit>
+
+lockstep_batch::lockstep_batch()
+	: arrangements(max_lines * lanes), filled(max_lines * lanes, 0), known(max_lines * lanes, 0)
+{
+}
+
+void lockstep_batch::clear()
+{
+	std::ranges::fill(arrangements, std::span<const mask>());
+	std::ranges::fill(filled, 0);
+	std::ranges::fill(known, 0);
+	dirty.fill(0);
+	count = 0;
+	stuck = contradicted = 0;
+}
+
+bool lockstep_batch::add(std::span<const std::vector<unsigned>> rowHints,
+                         std::span<const std::vector<unsigned>> colHints)
+{
+	const auto rows = static_cast<unsigned>(rowHints.size());
+	const auto cols = static_cast<unsigned>(colHints.size());
+
+	if (count == lanes || rows == 0 || cols == 0 || rows > max_cells || cols > max_cells)
+		return false;
+
+	const auto& table = line_table::get();
+	const unsigned lane = count;
+
+	for (unsigned line = 0; line < max_lines; ++line)
+	{
+		const bool is_row = line < max_cells;
+		const unsigned index = is_row ? line : line - max_cells;
+
+		std::span<const mask> lineArrangements;
+		if (is_row ? index < rows : index < cols)
+		{
+			lineArrangements = is_row ? table.arrangements(cols, rowHints[index])
+			                          : table.arrangements(rows, colHints[index]);
+			if (lineArrangements.empty())
+			{
+				for (unsigned undo = 0; undo < line; ++undo)
+					arrangements[undo * lanes + lane] = {};
+				return false;
+			}
+		}
+		arrangements[line * lanes + lane] = lineArrangements;
+	}
+
+	numrows[lane] = rows;
+	numcols[lane] = cols;
+
+	for (unsigned line = 0; line < max_lines; ++line)
+	{
+		if (!arrangements[line * lanes + lane].empty())
+			dirty[line] |= lane_set(1) << lane;
+	}
+
+	++count;
+	return true;
+}
+
+/*-------------------------------------------------------------
+Marks every cell of a line of a lane that has the same value in
+each arrangement agreeing with the cells already known, and flags
+the lines crossing it for solving in that lane. Returns false if
+no arrangement agrees.
+-------------------------------------------------------------*/
+
+bool lockstep_batch::solveLine(unsigned line, unsigned lane)
+{
+	const unsigned entry = line * lanes + lane;
+	const mask lineFilled = filled[entry], lineKnown = known[entry];
+
+	mask always = ~mask(0), ever = 0;
+	for (const auto arrangement : arrangements[entry])
+	{
+		if ((arrangement & lineKnown) == lineFilled)
+		{
+			always &= arrangement;
+			ever |= arrangement;
+		}
+	}
+
+	if (always & ~ever)
+		return false;
+
+	const unsigned length = (line < max_cells) ? numcols[lane] : numrows[lane];
+	const unsigned index = (line < max_cells) ? line : line - max_cells;
+
+	mask found = (always | ~ever) & ~lineKnown & ((mask(1) << length) - 1);
+	known[entry] |= found;
+	filled[entry] |= always & found;
+
+	for (; found; found &= found - 1)
+	{
+		const auto cell = static_cast<unsigned>(std::countr_zero(found));
+		const unsigned other = opposite(line, cell) * lanes + lane;
+
+		known[other] |= mask(1) << index;
+		if ((always >> cell) & 1)
+			filled[other] |= mask(1) << index;
+
+		dirty[opposite(line, cell)] |= lane_set(1) << lane;
+	}
+	return true;
+}
+
+void lockstep_batch::solve()
+{
+	for (bool progress = true; progress;)
+	{
+		progress = false;
+		for (unsigned line = 0; line < max_lines; ++line)
+		{
+			lane_set todo = dirty[line] & ~contradicted;
+			dirty[line] = 0;
+
+			for (; todo; todo &= todo - 1)
+			{
+				const auto lane = static_cast<unsigned>(std::countr_zero(todo));
+				if (!solveLine(line, lane))
+					contradicted |= lane_set(1) << lane;
+				progress = true;
+			}
+		}
+	}
+
+	stuck = 0;
+	for (unsigned lane = 0; lane < count; ++lane)
+	{
+		for (unsigned row = 0; row < numrows[lane]; ++row)
+		{
+			if (known[row * lanes + lane] != (mask(1) << numcols[lane]) - 1)
+				stuck |= lane_set(1) << lane;
+		}
+	}
+	stuck &= ~contradicted;
+}
+
+lockstep_batch::outcome lockstep_batch::result(unsigned lane) const
+{
+	if ((contradicted >> lane) & 1)
+		return outcome::contradiction;
+	return ((stuck >> lane) & 1) ? outcome::stuck : outcome::solved;
+}
+
+BMP_24 lockstep_batch::bitmap(unsigned lane) const
+{
+	const unsigned rows = numrows[lane], cols = numcols[lane];
+	BMP_24 soln(rows, cols);
+
+	for (unsigned row = 0; row < rows; ++row)
+	{
+		const mask rowFilled = filled[row * lanes + lane], rowKnown = known[row * lanes + lane];
+
+		// The rows in a bitmap are flipped.
+		for (unsigned col = 0; col < cols; ++col)
+		{
+			if ((rowFilled >> col) & 1)
+				soln(rows - 1 - row, col) = color_24_consts::black;
+			else if (!((rowKnown >> col) & 1))
+				soln(rows - 1 - row, col) = color_24_consts::gray;
+		}
+	}
+	return soln;
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+/*
+Line solves a batch of small puzzles together, one lane per puzzle, without
+building a nonagram for any of them. Every line of every lane is a pair of
+bit masks, laid out line by line with the lanes of each line side by side,
+and each step solves one line across every lane that needs it, from the
+arrangements in line_table. Lanes are tracked as bits of a 64 bit word.
+
+Line solving alone finishes most small puzzles. The rest are reported as
+stuck, to be searched the usual way.
+*/
+
+#include "bmp.hpp"
+#include "line_table.hpp"
+
+#include <array>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+class lockstep_batch
+{
+  public:
+	constexpr static unsigned lanes = 64;
+	constexpr static unsigned max_cells = line_table::max_cells;
+
+	enum class outcome
+	{
+		solved,
+		stuck,
+		contradiction
+	};
+
+  private:
+	using mask = line_table::mask;
+	using lane_set = std::uint64_t;
+
+	// Lines are rows, then columns from max_cells on. Entry
+	// [line * lanes + lane] is that line of that lane's puzzle.
+	constexpr static unsigned max_lines = 2 * max_cells;
+
+	std::array<unsigned, lanes> numrows{}, numcols{};
+	std::vector<std::span<const mask>> arrangements;
+	std::vector<mask> filled, known;
+
+	// The lanes each line needs solving in.
+	std::array<lane_set, max_lines> dirty{};
+
+	unsigned count = 0;
+	lane_set stuck = 0, contradicted = 0;
+
+	static unsigned opposite(unsigned line, unsigned cell)
+	{
+		return (line < max_cells) ? max_cells + cell : cell;
+	}
+
+	[[nodiscard]] bool solveLine(unsigned line, unsigned lane);
+
+  public:
+	lockstep_batch();
+
+	// Adds a puzzle in the next lane. Returns false, leaving the batch as it
+	// was, if the batch is full or the puzzle is too large for it, or has a
+	// line its hints cannot fit in.
+	[[nodiscard]] bool add(std::span<const std::vector<unsigned>> rowHints,
+	                       std::span<const std::vector<unsigned>> colHints);
+
+	unsigned size() const { return count; }
+
+	// Empties the batch for reuse, keeping its memory.
+	void clear();
+
+	// Line solves every lane until none can make progress.
+	void solve();
+
+	outcome result(unsigned lane) const;
+
+	// Whether a cell of a lane is known to be filled after solve().
+	bool isFilled(unsigned lane, unsigned row, unsigned col) const
+	{
+		return (filled[row * lanes + lane] >> col) & 1;
+	}
+
+	// The grid of a lane after solve(), unknown cells in gray.
+	BMP_24 bitmap(unsigned lane) const;
+};
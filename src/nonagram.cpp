@@ -2,11 +2,13 @@
 
 #include <algorithm>
 #include <numeric>
+#include <ranges>
+#include <system_error>
+#include <thread>
 
 nonagram::line::fill::fill(unsigned fl, unsigned start, unsigned end)
-	: length(fl), candidates(end - start + 1)
+	: length(fl), candidates(start, end)
 {
-	std::iota(candidates.begin(), candidates.end(), start);
 }
 
 /*--------------------------------------------------------------------
@@ -31,6 +33,9 @@ nonagram::line::line(index_generator<>&& refs, const std::vector<unsigned>& hint
 		fills.emplace_back(hint, minPos, minPos + extraSpace);
 		minPos += hint + 1;
 	}
+
+	if (grid.size() <= line_table::max_cells)
+		arrangements = line_table::get().arrangements(grid.size(), hintList);
 }
 
 /*-------------------------------------------------
@@ -45,7 +50,9 @@ static void getList(std::istream& in, std::vector<unsigned>& L)
 	in >> temp;
 	L.push_back(temp);
 
-	for (int c; (c = in.peek()) != '\n' && in;)
+	// Checking good() first keeps a missing newline at the end of the file
+	// from setting failbit.
+	for (int c; in.good() && (c = in.peek()) != '\n';)
 	{
 		if ('0' <= c && c <= '9')
 		{
@@ -172,11 +179,13 @@ std::ostream& operator<<(std::ostream& stream, nonagram::cell_state cs)
 
 /*---------------------------------------------------------
 Marks each cell in grid starting at index start and
-stopping before index end to 'value'. Returns false
-if any change is inconsistent with the existing value.
+stopping before index end to 'value', recording that the
+line at lin_index deduced them. Returns false if any
+change is inconsistent with the existing value.
 ---------------------------------------------------------*/
 
-bool nonagram::markInRange(line& lin, unsigned start, unsigned end, cell_state value)
+bool nonagram::markInRange(line& lin, unsigned start, unsigned end, cell_state value,
+                           unsigned lin_index)
 {
 	const auto end_iter = lin.grid.begin() + end;
 	for (auto iter = lin.grid.begin() + start; iter < end_iter; ++iter)
@@ -185,6 +194,8 @@ bool nonagram::markInRange(line& lin, unsigned start, unsigned end, cell_state v
 		if (grid[ref_index] == cell_state::unknown)
 		{
 			grid[ref_index] = value;
+			stamps[ref_index] = next_stamp++;
+			antecedents[ref_index] = lin_index;
 
 			const unsigned opposite_index =
 				lin.is_row ? (ref_index / numcols) : (ref_index % numcols);
@@ -195,7 +206,10 @@ bool nonagram::markInRange(line& lin, unsigned start, unsigned end, cell_state v
 			lines[opposite_line]->needs_line_solving = true;
 
 			if (!performSingleCellRules(value, opposite_line, opposite_index))
+			{
+				conflicts.push_back(opposite_line);
 				return false;
+			}
 		}
 		else if (grid[ref_index] != value)
 		{
@@ -214,8 +228,9 @@ bool nonagram::performSingleCellRules(cell_state value, unsigned lin, unsigned i
 			// If the filled space is immediately before or after
 			// a possible fill, remove the possibility.
 
-			std::erase_if(positions, [idx, length](unsigned start)
-			              { return (start == idx + 1) || (start + length == idx); });
+			positions.erase(idx + 1);
+			if (idx >= length)
+				positions.erase(idx - length);
 
 			if (positions.empty())
 				return false;
@@ -228,8 +243,7 @@ bool nonagram::performSingleCellRules(cell_state value, unsigned lin, unsigned i
 			// If the empty space is within the fill,
 			// remove the possibility.
 
-			std::erase_if(positions, [idx, length](unsigned start)
-			              { return (start <= idx) && (idx < start + length); });
+			positions.erase(idx + 1 > length ? idx + 1 - length : 0, idx + 1);
 
 			if (positions.empty())
 				return false;
@@ -362,7 +376,7 @@ candidates within this line to be invalidated (in other words, there
 is no need to call removeIncompatible after markConsistent is called).
 --------------------------------------------------------------------*/
 
-bool nonagram::markConsistent(line& lin)
+bool nonagram::markConsistent(line& lin, unsigned lin_index)
 {
 	// Mark filled spaces
 
@@ -377,7 +391,8 @@ bool nonagram::markConsistent(line& lin)
 	{
 		// Mark every cell from the last possible start position of the fill to
 		// the first possible end position of the fill. This may not mark anything.
-		if (!markInRange(lin, positions.back(), positions.front() + length, cell_state::filled))
+		if (!markInRange(lin, positions.back(), positions.front() + length, cell_state::filled,
+		                 lin_index))
 			return false;
 	}
 
@@ -390,7 +405,7 @@ bool nonagram::markConsistent(line& lin)
 	// Mark every cell that is before all possible start positions of the first
 	// fill as empty.
 
-	if (!markInRange(lin, 0, lin.fills[0].candidates.front(), cell_state::empty))
+	if (!markInRange(lin, 0, lin.fills[0].candidates.front(), cell_state::empty, lin_index))
 		return false;
 
 	// Mark every cell that is after all possible end positions of the last
@@ -398,7 +413,7 @@ bool nonagram::markConsistent(line& lin)
 
 	unsigned lastoflast = lin.fills.back().candidates.back() + lin.fills.back().length;
 
-	if (!markInRange(lin, lastoflast, lin.grid.size(), cell_state::empty))
+	if (!markInRange(lin, lastoflast, lin.grid.size(), cell_state::empty, lin_index))
 		return false;
 
 	// For each consecutive pair of fills, fill any gaps between
@@ -409,25 +424,209 @@ bool nonagram::markConsistent(line& lin)
 		unsigned lastoffirst = lin.fills[i - 1].candidates.back() + lin.fills[i - 1].length;
 		unsigned firstoflast = lin.fills[i].candidates.front();
 
-		if (!markInRange(lin, lastoffirst, firstoflast, cell_state::empty))
+		if (!markInRange(lin, lastoffirst, firstoflast, cell_state::empty, lin_index))
 			return false;
 	}
 	return true;
 }
 
+/*--------------------------------------------------------------------
+Works out which fills could own each run of filled cells, that is,
+cover it while staying within the cells around it that are not empty.
+The run is then at least as long as the shortest of them can make it
+within those cells, and is complete, bounded by empty cells, if it is
+as long as the longest. If only one fill can own it, that fill loses
+every candidate that does not cover it, in which case 'changed' is
+set and the line needs solving again. Catches runs such as the middle
+of '? ? ? _ ? X ? _ ? ? ?' with hints 3 3, which the candidate rules
+alone do not. Expects removeIncompatible() to have just been called.
+--------------------------------------------------------------------*/
+
+bool nonagram::markByOwners(line& lin, unsigned lin_index, bool& changed)
+{
+	const unsigned size = lin.grid.size();
+	const auto value = [&](unsigned i) { return grid[lin.grid[i]]; };
+
+	for (unsigned gap_start = 0; gap_start < size;)
+	{
+		if (value(gap_start) == cell_state::empty)
+		{
+			++gap_start;
+			continue;
+		}
+
+		// Cells marked below may split the gap, which only makes what is
+		// deduced from it weaker, never wrong.
+		unsigned gap_end = gap_start + 1;
+		while (gap_end < size && value(gap_end) != cell_state::empty)
+			++gap_end;
+
+		for (unsigned run_start = gap_start; run_start < gap_end;)
+		{
+			if (value(run_start) != cell_state::filled)
+			{
+				++run_start;
+				continue;
+			}
+
+			// Runs grow as cells are marked, so always take the whole of one.
+			while (run_start > gap_start && value(run_start - 1) == cell_state::filled)
+				--run_start;
+			unsigned run_end = run_start + 1;
+			while (run_end < gap_end && value(run_end) == cell_state::filled)
+				++run_end;
+
+			// Fronts and backs only grow along the line, so the fills that can
+			// reach the run are consecutive.
+			const auto first = std::ranges::partition_point(
+				lin.fills, [&](const line::fill& f)
+				{ return f.candidates.back() + f.length < run_end; });
+			const auto last = std::ranges::partition_point(
+				lin.fills, [&](const line::fill& f) { return f.candidates.front() <= run_start; });
+
+			unsigned owners = 0, shortest = size, longest = 0;
+			line::fill* owner = nullptr;
+			unsigned owner_low = 0, owner_high = 0;
+
+			for (auto it = first; it < last; ++it)
+			{
+				const unsigned length = it->length;
+				if (length < run_end - run_start || length > gap_end - gap_start)
+					continue;
+
+				const unsigned low = std::max(gap_start, run_end > length ? run_end - length : 0);
+				const unsigned high = std::min(run_start, gap_end - length);
+				if (low > high || it->candidates.next(low) > high)
+					continue;
+
+				++owners;
+				shortest = std::min(shortest, length);
+				longest = std::max(longest, length);
+				owner = &*it;
+				owner_low = low;
+				owner_high = high;
+			}
+
+			if (owners == 0)
+				return false;
+
+			const unsigned before = next_stamp;
+
+			// The run reaches at least as far as the shortest owner would from
+			// either end of the gap.
+			if (gap_start + shortest > run_end &&
+			    !markInRange(lin, run_end, gap_start + shortest, cell_state::filled, lin_index))
+				return false;
+			if (gap_end - shortest < run_start &&
+			    !markInRange(lin, gap_end - shortest, run_start, cell_state::filled, lin_index))
+				return false;
+
+			if (run_end - run_start == longest)
+			{
+				if (run_start > 0 &&
+				    !markInRange(lin, run_start - 1, run_start, cell_state::empty, lin_index))
+					return false;
+				if (run_end < size &&
+				    !markInRange(lin, run_end, run_end + 1, cell_state::empty, lin_index))
+					return false;
+			}
+
+			if (owners == 1)
+			{
+				auto& candidates = owner->candidates;
+				if (candidates.front() < owner_low || owner_high < candidates.back())
+				{
+					candidates.erase(candidates.front(), owner_low);
+					candidates.erase(owner_high + 1, candidates.back() + 1);
+
+					// The other fills are no longer pushed clear of this one,
+					// so the ranges above cannot be trusted until they are.
+					changed = true;
+					return true;
+				}
+			}
+
+			// Look at the same run again if it grew.
+			if (next_stamp == before)
+				run_start = run_end;
+		}
+
+		gap_start = gap_end;
+	}
+	return true;
+}
+
+/*-------------------------------------------------------------
+Marks every cell of a short line that has the same value in all
+of its arrangements that agree with the cells already known.
+Returns false if none agree.
+-------------------------------------------------------------*/
+
+bool nonagram::markArrangements(line& lin, unsigned lin_index)
+{
+	line_table::mask filled = 0, known = 0;
+	for (unsigned i = 0; i < lin.grid.size(); ++i)
+	{
+		const auto value = grid[lin.grid[i]];
+		if (value != cell_state::unknown)
+			known |= line_table::mask(1) << i;
+		if (value == cell_state::filled)
+			filled |= line_table::mask(1) << i;
+	}
+
+	line_table::mask always = ~line_table::mask(0), ever = 0;
+	for (const auto arrangement : lin.arrangements)
+	{
+		if ((arrangement & known) == filled)
+		{
+			always &= arrangement;
+			ever |= arrangement;
+		}
+	}
+
+	// Nothing agreed.
+	if (always & ~ever)
+		return false;
+
+	for (unsigned i = 0; i < lin.grid.size(); ++i)
+	{
+		if ((known >> i) & 1)
+			continue;
+
+		if ((always >> i) & 1)
+		{
+			if (!markInRange(lin, i, i + 1, cell_state::filled, lin_index))
+				return false;
+		}
+		else if (!((ever >> i) & 1))
+		{
+			if (!markInRange(lin, i, i + 1, cell_state::empty, lin_index))
+				return false;
+		}
+	}
+	return true;
+}
+
 /*-------------------------------------------------------------
-Calls removeIncompatible() and markConsistent(), in that order,
-on each line. Returns false if any line is unsolvable.
+Calls removeIncompatible(), markByOwners() and markConsistent(),
+in that order, on each line, or markArrangements() on lines
+short enough for it. Returns false if any line is unsolvable.
 -------------------------------------------------------------*/
 
-bool nonagram::line_solve()
+bool nonagram::line_solve(bool overlap_only)
 {
+	conflicts.clear();
+
+#ifdef CPUZZLE_TRACE
+	trace::scope pass(tracer, "line_solve");
+#endif
+
 	// Index of the last line that was line solved in this method call,
-	// starts as an unreachable value. It is assumed that at least one line
-	// is marked for line solving.
+	// starts as an unreachable value.
 	unsigned last_solved = static_cast<unsigned>(lines.size());
 	while (true)
 	{
+		++line_passes;
 		for (unsigned i = 0; i < lines.size(); ++i)
 		{
 			if (i == last_solved)
@@ -438,10 +637,45 @@ bool nonagram::line_solve()
 			if (!lin || !lin->needs_line_solving)
 				continue;
 
-			if (!removeIncompatible(*lin))
-				return false;
-			if (!markConsistent(*lin))
+#ifdef CPUZZLE_TRACE
+			const auto line_start = trace::clock::now();
+			const unsigned first_stamp = next_stamp;
+#endif
+
+			++lines_solved;
+			bool consistent;
+			if (overlap_only)
+				consistent = markConsistent(*lin, i);
+			else if (!lin->arrangements.empty())
+				consistent = markArrangements(*lin, i);
+			else
+			{
+				// Solve the line again for as long as markByOwners() narrows
+				// it, so that it is left at a fixpoint like the other lines.
+				bool changed;
+				do
+				{
+					changed = false;
+					consistent = removeIncompatible(*lin) && markByOwners(*lin, i, changed) &&
+					             markConsistent(*lin, i);
+				} while (consistent && changed);
+			}
+
+#ifdef CPUZZLE_TRACE
+			if (tracer)
+			{
+				tracer->complete(i < numrows ? "row" : "column", line_start, trace::clock::now(),
+				                 {{"index", i < numrows ? i : i - numrows},
+				                  {"fixed", next_stamp - first_stamp},
+				                  {"contradiction", !consistent}});
+			}
+#endif
+
+			if (!consistent)
+			{
+				conflicts.push_back(i);
 				return false;
+			}
 
 			// If the line is solved, remove it and reduce the number of
 			// remaining lines to solve.
@@ -457,165 +691,1423 @@ bool nonagram::line_solve()
 
 			last_solved = i;
 		}
+
+		// No line was marked for line solving.
+		if (last_solved == lines.size())
+			return true;
 	}
 }
 
-std::istream& operator>>(std::istream& stream, nonagram& CP)
+nonagram::nonagram(std::span<const std::vector<unsigned>> rowHints,
+                   std::span<const std::vector<unsigned>> colHints)
+	: numrows(static_cast<unsigned>(rowHints.size())),
+	  numcols(static_cast<unsigned>(colHints.size())),
+	  grid(numrows * numcols, cell_state::unknown), lines(numrows + numcols),
+	  lines_to_solve(numrows + numcols), stamps(grid.size(), 0),
+	  antecedents(grid.size(), no_line), reasons(grid.size(), 0)
 {
-	stream >> CP.numcols >> CP.numrows;
-
-#ifdef CPUZZLE_DEBUG
-	std::cout << "Rows: " << CP.numrows << ", Cols: " << CP.numcols << '\n';
-#endif
-
-	CP.lines.resize(CP.lines_to_solve = CP.numcols + CP.numrows);
-
-	// Create grid, fill with "unknown"
-	CP.grid.resize(CP.numrows * CP.numcols);
-	std::ranges::fill(CP.grid, nonagram::cell_state::unknown);
+	auto hintLists =
+		std::make_shared<std::vector<std::vector<unsigned>>>(rowHints.begin(), rowHints.end());
+	hintLists->insert(hintLists->end(), colHints.begin(), colHints.end());
+	hints = std::move(hintLists);
 
 #ifdef CPUZZLE_DEBUG
+	std::cout << "Rows: " << numrows << ", Cols: " << numcols << '\n';
 	std::cout << "Hintlists:\n";
 #endif
 
-	std::vector<unsigned> hintList;
-	for (unsigned i = 0; i < CP.numrows; ++i)
+	for (unsigned i = 0; i < numrows; ++i)
 	{
-		getList(stream, hintList);
-
 #ifdef CPUZZLE_DEBUG
 		std::cout << "    Row " << i << ": ";
 #endif
 
-		CP.evaluateHintList(index_generator(CP.numcols * i, 1u, CP.numcols), hintList, i, true);
-
-		hintList.clear();
+		evaluateHintList(index_generator(numcols * i, 1u, numcols), rowHints[i], i, true);
 	}
 
-	for (unsigned i = 0; i < CP.numcols; ++i)
+	for (unsigned i = 0; i < numcols; ++i)
 	{
-		getList(stream, hintList);
-
 #ifdef CPUZZLE_DEBUG
 		std::cout << "    Column " << i << ": ";
 #endif
 
-		CP.evaluateHintList(index_generator(i, CP.numcols, CP.numrows), hintList, CP.numrows + i,
-		                    false);
+		evaluateHintList(index_generator(i, numcols, numrows), colHints[i], numrows + i, false);
+	}
+}
+
+std::istream& nonagram::readHints(std::istream& stream,
+                                  std::vector<std::vector<unsigned>>& rowHints,
+                                  std::vector<std::vector<unsigned>>& colHints)
+{
+	unsigned numcols, numrows;
+	stream >> numcols >> numrows;
 
-		hintList.clear();
+	// Cell indexes, and one past the end of each line, must fit in an unsigned.
+	if (!stream || (std::uint64_t(numrows) + 1) * (std::uint64_t(numcols) + 1) > ~0u)
+	{
+		stream.setstate(std::ios_base::failbit);
+		return stream;
 	}
 
-#ifdef CPUZZLE_DEBUG
-	std::cout << "Successfully read from file.\n";
-#endif
+	// Lists keep their memory, for callers that read many puzzles into the
+	// same vectors.
+	rowHints.resize(numrows);
+	colHints.resize(numcols);
+	for (auto& hintList : rowHints)
+		hintList.clear();
+	for (auto& hintList : colHints)
+		hintList.clear();
+
+	for (auto& hintList : rowHints)
+		getList(stream, hintList);
+
+	for (auto& hintList : colHints)
+		getList(stream, hintList);
 
 	return stream;
 }
 
-bool nonagram::solve()
-{
-#ifdef CPUZZLE_DEBUG
-	std::cout << "Entering solve:\nPuzzle:\n" << *this << "Line solving:\n";
-#endif
+/*-------------------------------------------------------------
+For each of 'length' cells across a set of lines, counts how many
+of the lines can fill it and how many must, going by where their
+fills reach when placed as far left and as far right as they go.
+The lines must fit their hints.
+-------------------------------------------------------------*/
 
-	if (!line_solve())
-		return false;
+static void crossCounts(std::span<const std::vector<unsigned>> lineHints, unsigned length,
+                        std::vector<std::int64_t>& can, std::vector<std::int64_t>& must)
+{
+	// Differences between consecutive counts, summed up at the end.
+	can.assign(length + 1, 0);
+	must.assign(length + 1, 0);
 
-	if (isComplete())
+	for (const auto& hintList : lineHints)
 	{
-#ifdef CPUZZLE_DEBUG
-		std::cout << "Puzzle complete:\n" << *this;
-#endif
+		if (hintList.empty())
+			continue;
 
-		return true;
+		const auto needed = std::accumulate(hintList.begin(), hintList.end(), 0U) +
+		                    static_cast<unsigned>(hintList.size()) - 1;
+		const unsigned slack = length - needed;
+
+		// Each fill can reach from its leftmost start to its rightmost end.
+		// These overlap when there is slack, so are merged before counting.
+		unsigned start = 0, reach_start = 0, reach_end = 0;
+		for (const auto hint : hintList)
+		{
+			if (start > reach_end)
+			{
+				++can[reach_start];
+				--can[reach_end];
+				reach_start = start;
+			}
+			reach_end = start + slack + hint;
+
+			if (slack < hint)
+			{
+				++must[start + slack];
+				--must[start + hint];
+			}
+			start += hint + 1;
+		}
+		++can[reach_start];
+		--can[reach_end];
 	}
 
-#ifdef CPUZZLE_DEBUG
-	std::cout << "\nUsing brute force, " << lines_to_solve
-			  << " lines left"
-				 " to solve:\n\n";
-#endif
+	for (unsigned i = 1; i <= length; ++i)
+	{
+		can[i] += can[i - 1];
+		must[i] += must[i - 1];
+	}
+}
 
-	// find position to brute force
-	unsigned pos = 0;
-	while (grid[pos] != cell_state::unknown)
-		++pos;
+nonagram::hint_check nonagram::checkHints(std::span<const std::vector<unsigned>> rowHints,
+                                          std::span<const std::vector<unsigned>> colHints)
+{
+	const auto numrows = static_cast<unsigned>(rowHints.size());
+	const auto numcols = static_cast<unsigned>(colHints.size());
 
-	const unsigned rownum = pos / numcols, colnum = pos % numcols;
+	hint_check check;
+	std::uint64_t totals[2] = {0, 0};
 
-	// Mark the affected row and column, respectfully, as needing line solving.
-	lines[rownum]->needs_line_solving = true;
-	lines[numrows + colnum]->needs_line_solving = true;
+	for (const bool is_row : {true, false})
+	{
+		const auto lineHints = is_row ? rowHints : colHints;
+		const unsigned length = is_row ? numcols : numrows;
 
-	// For now, naively guess filled. This guess will be improved in the future.
-	auto guess = cell_state::filled;
+		for (unsigned i = 0; i < lineHints.size(); ++i)
+		{
+			check.is_row = is_row;
+			check.index = i;
+
+			std::uint64_t filled = 0;
+			for (const auto hint : lineHints[i])
+			{
+				if (hint == 0)
+				{
+					check.what = hint_check::problem::zero_hint;
+					return check;
+				}
+				filled += hint;
+			}
 
-	nonagram copy(*this);
+			const std::uint64_t needed =
+				lineHints[i].empty() ? 0 : filled + lineHints[i].size() - 1;
+			if (needed > length)
+			{
+				check.what = hint_check::problem::overfull_line;
+				check.count = needed;
+				check.high = length;
+				return check;
+			}
 
-#ifdef CPUZZLE_DEBUG
-	std::cout << "Guessing " << (guess == cell_state::filled ? "filled" : "empty")
-			  << " at position " << pos << "(" << (pos / numrows) << "," << (pos % numrows)
-			  << ")\n";
-#endif
+			totals[is_row ? 0 : 1] += filled;
+		}
+	}
 
-	copy.grid[pos] = guess;
+	if (totals[0] != totals[1])
+	{
+		check.what = hint_check::problem::unequal_totals;
+		check.count = totals[0];
+		check.high = totals[1];
+		return check;
+	}
 
-	// Perform single cell rules on row, then column.
-	if (copy.performSingleCellRules(guess, rownum, colnum) &&
-	    copy.performSingleCellRules(guess, numrows + colnum, rownum))
+	std::vector<std::int64_t> can, must;
+	for (const bool is_row : {true, false})
 	{
-		if (copy.solve())
+		const auto lineHints = is_row ? rowHints : colHints;
+		crossCounts(is_row ? colHints : rowHints, static_cast<unsigned>(lineHints.size()), can,
+		            must);
+
+		for (unsigned i = 0; i < lineHints.size(); ++i)
 		{
-			std::swap(copy, *this);
-			return true;
+			const auto filled = std::accumulate(lineHints[i].begin(), lineHints[i].end(),
+			                                    std::uint64_t(0));
+			const auto low = static_cast<std::uint64_t>(must[i]);
+			const auto high = static_cast<std::uint64_t>(can[i]);
+
+			if (filled < low || high < filled)
+			{
+				check.what = hint_check::problem::cross_count;
+				check.is_row = is_row;
+				check.index = i;
+				check.count = filled;
+				check.low = low;
+				check.high = high;
+				return check;
+			}
 		}
 	}
 
-	guess = (guess == cell_state::filled) ? cell_state::empty : cell_state::filled;
+	check = {};
+	return check;
+}
+
+std::ostream& operator<<(std::ostream& stream, const nonagram::hint_check& check)
+{
+	using problem = nonagram::hint_check::problem;
+
+	if (check.what == problem::none)
+		return stream << "no problem found";
+
+	if (check.what == problem::unequal_totals)
+	{
+		return stream << "the rows fill " << check.count << " cells but the columns fill "
+					  << check.high;
+	}
+
+	stream << (check.is_row ? "row " : "column ") << check.index;
+	switch (check.what)
+	{
+	case problem::zero_hint:
+		return stream << " has a hint of 0 among others";
+	case problem::overfull_line:
+		return stream << " needs " << check.count << " cells but has " << check.high;
+	default:
+		return stream << " fills " << check.count << " cells but the lines crossing it allow "
+					  << check.low << " to " << check.high;
+	}
+}
+
+std::istream& operator>>(std::istream& stream, nonagram& CP)
+{
+	std::vector<std::vector<unsigned>> rowHints, colHints;
+	if (!nonagram::readHints(stream, rowHints, colHints))
+		return stream;
+
+	if (!nonagram::checkHints(rowHints, colHints))
+	{
+		stream.setstate(std::ios_base::failbit);
+		return stream;
+	}
+
+	CP = nonagram(rowHints, colHints);
 
 #ifdef CPUZZLE_DEBUG
-	std::cout << "Guess at position " << pos << "(" << (pos / numrows) << "," << (pos % numrows)
-			  << ") was incorrect, trying " << (guess == cell_state::filled ? "filled" : "empty")
-			  << " instead\n";
+	std::cout << "Successfully read from file.\n";
 #endif
 
-	// No need to use the copy anymore, if this solves the puzzle the solution
-	// is already in place, if not, the puzzle is "junk" anyways.
-	grid[pos] = guess;
+	return stream;
+}
 
-	// Perform single cell rules on row, then column.
-	if (!performSingleCellRules(guess, rownum, colnum))
-		return false;
-	if (!performSingleCellRules(guess, colnum + numrows, rownum))
-		return false;
+bool nonagram::deduce()
+{
+	conflicts.clear();
 
-	// Since this is the last attempt, let the result escalate.
-	return solve();
+	// line_solve() assumes at least one line is marked, which does not hold
+	// if every line was empty.
+	return isComplete() || line_solve();
 }
 
-bool nonagram::isComplete() const { return lines_to_solve == 0; }
+/*-------------------------------------------------------------
+Returns the indexes of the cells in line 'lin', where lines
+numbered numrows and up are columns.
+-------------------------------------------------------------*/
 
-BMP_24 nonagram::bitmap() const
+index_generator<> nonagram::lineCells(unsigned lin) const
 {
-	BMP_24 soln(numrows, numcols);
+	return lin < numrows ? index_generator(numcols * lin, 1u, numcols)
+	                     : index_generator(lin - numrows, numcols, numrows);
+}
 
-	unsigned pos = 0;
-	for (unsigned i = 0; i < numrows; ++i)
+/*-------------------------------------------------------------
+Returns the levels whose guesses were already made when the cell
+with the given stamp was assigned, which its reason is a subset of.
+-------------------------------------------------------------*/
+
+nonagram::reason_set nonagram::reasonBound(const search_state& state, unsigned stamp)
+{
+	const auto guesses = static_cast<unsigned>(
+		std::ranges::upper_bound(state.decisions, stamp, {}, &decision::stamp) -
+		state.decisions.begin());
+
+	return (guesses >= reason_bits) ? ~reason_set(0) : (reason_set(1) << guesses) - 1;
+}
+
+/*-------------------------------------------------------------
+Returns true if the fills in hintList can be placed in cells
+without covering an empty cell or leaving a filled cell out.
+-------------------------------------------------------------*/
+
+static bool fits(std::span<const nonagram::cell_state> cells,
+                 const std::vector<unsigned>& hintList)
+{
+	const std::size_t n = cells.size(), k = hintList.size();
+
+	// Kept between calls, since this runs many times per conflict.
+	thread_local std::vector<std::size_t> empties;
+	thread_local std::vector<char> placed;
+
+	// empties[i] is the number of empty cells before cell i.
+	empties.assign(n + 1, 0);
+	for (std::size_t i = 0; i < n; ++i)
 	{
-		// The rows in a bitmap are flipped, so when writing,
-		// write to the opposite side.
-		unsigned rowNum = numrows - 1 - i;
-		for (unsigned j = 0; j < numcols; ++j)
+		empties[i + 1] = empties[i] + (cells[i] == nonagram::cell_state::empty);
+	}
+
+	// placed[i * (k + 1) + j] is true if the first i cells can hold exactly
+	// the first j fills.
+	placed.assign((n + 1) * (k + 1), false);
+	placed[0] = true;
+
+	for (std::size_t i = 1; i <= n; ++i)
+	{
+		for (std::size_t j = 0; j <= k; ++j)
 		{
-			if (grid[pos] == cell_state::filled)
+			// Cell i - 1 is left empty.
+			bool can = cells[i - 1] != nonagram::cell_state::filled &&
+			           placed[(i - 1) * (k + 1) + j];
+
+			// Fill j - 1 ends at cell i - 1, after an empty cell unless it
+			// starts the line.
+			if (!can && j > 0 && i >= hintList[j - 1] && empties[i] == empties[i - hintList[j - 1]])
 			{
-				soln(rowNum, j) = color_24_consts::black;
+				const std::size_t start = i - hintList[j - 1];
+
+				can = (start == 0) ? (j == 1)
+				                   : (cells[start - 1] != nonagram::cell_state::filled &&
+				                      placed[(start - 1) * (k + 1) + j - 1]);
 			}
-			// base color is white
 
-			++pos;
+			placed[i * (k + 1) + j] = can;
 		}
 	}
-	return soln;
+	return placed[n * (k + 1) + k];
+}
+
+/*-------------------------------------------------------------
+Given the cells of a line that cannot be filled in as they are,
+forgets as many known cells as possible, latest first, while the
+line still cannot be filled. Returns the levels the remaining
+cells depend on. The cell at index 'fixed' is never forgotten.
+-------------------------------------------------------------*/
+
+nonagram::reason_set nonagram::explainLine(search_state& state, unsigned lin,
+                                           std::vector<cell_state>& cells, unsigned fixed)
+{
+	const auto refs = lineCells(lin);
+	const auto& hintList = (*hints)[lin];
+
+	// Cells known from the start need no explaining, so leave them be.
+	std::vector<unsigned> order;
+	for (unsigned i = 0; i < cells.size(); ++i)
+	{
+		if (i != fixed && cells[i] != cell_state::unknown &&
+		    (antecedents[refs[i]] != no_line ? reasonBound(state, stamps[refs[i]]) != 0
+		                                     : reasons[refs[i]] != 0))
+		{
+			order.push_back(i);
+		}
+	}
+
+	std::ranges::sort(order, [&](unsigned a, unsigned b)
+	                  { return stamps[refs[a]] > stamps[refs[b]]; });
+
+	for (const auto i : order)
+	{
+		if (state.budget == 0)
+			break;
+		--state.budget;
+
+		const auto saved = cells[i];
+		cells[i] = cell_state::unknown;
+		if (fits(cells, hintList))
+			cells[i] = saved;
+	}
+
+	// Older cells first, as they tend to depend on fewer levels and may
+	// already cover the newer ones.
+	reason_set reason = 0;
+	for (const auto i : std::views::reverse(order))
+	{
+		if (cells[i] == cell_state::unknown)
+			continue;
+
+		if (antecedents[refs[i]] != no_line && (reasonBound(state, stamps[refs[i]]) & ~reason) == 0)
+			continue;
+
+		reason |= cellReason(state, refs[i]);
+	}
+	return reason;
+}
+
+/*-------------------------------------------------------------
+Returns the levels whose guesses the value of a cell depends on.
+A cell deduced by line solving is explained by the cells of its
+line that were known before it, and so on recursively.
+-------------------------------------------------------------*/
+
+nonagram::reason_set nonagram::cellReason(search_state& state, unsigned pos)
+{
+	if (antecedents[pos] == no_line)
+		return reasons[pos];
+
+	// Once the budget runs out, following the chain of deductions further
+	// costs more than what a tighter reason would save.
+	const reason_set bound = reasonBound(state, stamps[pos]);
+	if (bound == 0 || state.budget == 0)
+		return bound;
+
+	if (const auto found = state.explained.find(stamps[pos]); found != state.explained.end())
+		return found->second;
+
+	const unsigned lin = antecedents[pos];
+
+	// The line as it was when the cell was deduced, with the cell set the
+	// other way, which must not fit.
+	std::vector<cell_state> cells;
+	unsigned fixed = 0;
+	for (const auto ref : lineCells(lin))
+	{
+		if (ref == pos)
+		{
+			fixed = static_cast<unsigned>(cells.size());
+			cells.push_back(grid[pos] == cell_state::filled ? cell_state::empty
+			                                                : cell_state::filled);
+		}
+		else
+		{
+			cells.push_back(stamps[ref] < stamps[pos] ? grid[ref] : cell_state::unknown);
+		}
+	}
+
+	reasons[pos] = explainLine(state, lin, cells, fixed);
+	antecedents[pos] = no_line;
+	state.explained.emplace(stamps[pos], reasons[pos]);
+	return reasons[pos];
+}
+
+/*-------------------------------------------------------------
+Returns the levels whose guesses caused the contradiction found
+on the lines in 'conflicts'.
+-------------------------------------------------------------*/
+
+nonagram::reason_set nonagram::conflictReason(search_state& state)
+{
+	state.budget = search_state::explain_budget;
+
+	for (const auto lin : conflicts)
+	{
+		std::vector<cell_state> cells;
+		for (const auto ref : lineCells(lin))
+		{
+			cells.push_back(grid[ref]);
+		}
+
+		if (!fits(cells, (*hints)[lin]))
+			return explainLine(state, lin, cells, no_line);
+	}
+
+	// Should not happen, but blaming every guess is always safe.
+	return ~reason_set(0);
+}
+
+/*-------------------------------------------------------------
+Sets an unknown cell to 'value', depending on the guesses in
+'reason', and applies the single cell rules to its row and
+column. Returns false if either becomes unsolvable.
+-------------------------------------------------------------*/
+
+bool nonagram::assign(unsigned pos, cell_state value, reason_set reason)
+{
+	conflicts.clear();
+
+	const unsigned rownum = pos / numcols, colnum = pos % numcols;
+
+	grid[pos] = value;
+	stamps[pos] = next_stamp++;
+	antecedents[pos] = no_line;
+	reasons[pos] = reason;
+
+	// Mark the affected row and column, respectfully, as needing line solving.
+	lines[rownum]->needs_line_solving = true;
+	lines[numrows + colnum]->needs_line_solving = true;
+
+	// Perform single cell rules on row, then column.
+	if (!performSingleCellRules(value, rownum, colnum))
+	{
+		conflicts.push_back(rownum);
+		return false;
+	}
+	if (!performSingleCellRules(value, numrows + colnum, rownum))
+	{
+		conflicts.push_back(numrows + colnum);
+		return false;
+	}
+	return true;
+}
+
+/*-------------------------------------------------------------
+Returns where the nogoods holding a cell's value are listed.
+-------------------------------------------------------------*/
+
+static std::size_t holdingIndex(unsigned pos, nonagram::cell_state value)
+{
+	return std::size_t(pos) * 2 + (value == nonagram::cell_state::filled);
+}
+
+/*-------------------------------------------------------------
+Checks the grid against the learned nogoods. A nogood with every
+assignment in place is a contradiction, and one with all but one
+in place forces the remaining cell to the other value. Sets
+'changed' if any cell was forced.
+
+Only nogoods learned since the last check, and those holding a
+cell assigned since, are looked at. A nogood one of whose cells
+is set the other way stays out of use in this part of the
+search, and one with two unknown cells left will come up again
+once either of them is assigned.
+-------------------------------------------------------------*/
+
+bool nonagram::applyNogoods(search_state& state, bool& changed, reason_set& conflict)
+{
+	const unsigned since = nogoods_stamp, until = next_stamp;
+	const std::size_t learned = nogoods_checked;
+	nogoods_stamp = next_stamp;
+	nogoods_checked = state.nogoods.size();
+	++state.pass;
+
+	const auto check = [&](unsigned index)
+	{
+		if (state.checked_in[index] == state.pass)
+			return true;
+		state.checked_in[index] = state.pass;
+
+		const auto& ng = state.nogoods[index];
+		const literal* open = nullptr;
+		for (const auto& lit : ng)
+		{
+			const auto value = grid[lit.pos];
+			if (value == cell_state::unknown)
+			{
+				if (open)
+					return true;
+				open = &lit;
+			}
+			else if (value != lit.value)
+			{
+				return true;
+			}
+		}
+
+		// Only now is it worth explaining the cells in place.
+		reason_set reason = 0;
+		state.budget = search_state::explain_budget;
+		for (const auto& lit : ng)
+		{
+			if (&lit != open)
+				reason |= cellReason(state, lit.pos);
+		}
+
+		if (!open)
+		{
+			conflict = reason;
+			return false;
+		}
+
+		const auto forced =
+			(open->value == cell_state::filled) ? cell_state::empty : cell_state::filled;
+
+		if (!assign(open->pos, forced, reason))
+		{
+			conflict = conflictReason(state);
+			return false;
+		}
+		changed = true;
+		return true;
+	};
+
+	for (auto index = static_cast<unsigned>(learned); index < nogoods_checked; ++index)
+	{
+		if (!check(index))
+			return false;
+	}
+
+	for (unsigned pos = 0; pos < grid.size(); ++pos)
+	{
+		if (grid[pos] == cell_state::unknown || stamps[pos] < since || stamps[pos] >= until)
+			continue;
+
+		const auto assignment = holdingIndex(pos, grid[pos]);
+		if (assignment >= state.holding.size())
+			continue;
+
+		for (const auto index : state.holding[assignment])
+		{
+			if (!check(index))
+				return false;
+		}
+	}
+	return true;
+}
+
+/*-------------------------------------------------------------
+Records the guesses in 'conflict' as a nogood, if it is small
+enough to be worth checking and the store is not full.
+-------------------------------------------------------------*/
+
+void nonagram::learn(search_state& state, reason_set conflict) const
+{
+	constexpr std::size_t max_nogood_size = 16, max_nogoods = 4096;
+
+	// Levels sharing the last bit cannot be told apart.
+	if (conflict >> (reason_bits - 1) || state.nogoods.size() >= max_nogoods)
+		return;
+
+	nogood ng;
+	for (unsigned level = 0; conflict; ++level, conflict >>= 1)
+	{
+		if (conflict & 1)
+		{
+			if (ng.size() == max_nogood_size)
+				return;
+			ng.push_back(state.decisions[level].guess);
+		}
+	}
+	state.addNogood(std::move(ng));
+}
+
+/*-------------------------------------------------------------
+Solves the puzzle by line solving and guessing, with 'level'
+guesses made so far on this branch. On failure, sets 'conflict'
+to the earlier guesses that caused it: if the guess made here is
+not among them, the other value would fail the same way, so the
+search jumps straight back to the latest guess that is.
+-------------------------------------------------------------*/
+
+bool nonagram::search(search_state& state, unsigned level, reason_set& conflict)
+{
+	++state.nodes;
+	state.depth = std::max(state.depth, level);
+
+	// Looking at the clock every node would cost more than it is worth.
+	if (state.saver && state.nodes % 1024 == 0 && state.replayed == state.replay.size() &&
+	    std::chrono::steady_clock::now() >= state.next_save)
+	{
+		state.saveProgress();
+	}
+
+#ifdef CPUZZLE_TRACE
+	trace::scope node(tracer, "search", {{"level", level}});
+#endif
+
+#ifdef CPUZZLE_DEBUG
+	std::cout << "Entering solve:\nPuzzle:\n" << *this << "Line solving:\n";
+#endif
+
+	for (bool changed = true; changed && !isComplete();)
+	{
+		if (!line_solve())
+		{
+			conflict = conflictReason(state);
+			return false;
+		}
+
+		changed = false;
+		if (!isComplete() && !applyNogoods(state, changed, conflict))
+			return false;
+	}
+
+	if (isComplete())
+	{
+#ifdef CPUZZLE_DEBUG
+		std::cout << "Puzzle complete:\n" << *this;
+#endif
+
+		return true;
+	}
+
+#ifdef CPUZZLE_DEBUG
+	std::cout << "\nUsing brute force, " << lines_to_solve
+			  << " lines left"
+				 " to solve:\n\n";
+#endif
+
+	unsigned pos = 0;
+
+	// For now, naively guess filled. This guess will be improved in the future.
+	auto guess = cell_state::filled;
+
+	if (const auto step = nextReplayStep(state))
+	{
+		pos = step->cell.pos;
+		guess = step->cell.filled ? cell_state::filled : cell_state::empty;
+
+		// The guess was refuted before the checkpoint, so only the other
+		// value is left.
+		if (!step->guess)
+		{
+			state.decisions.resize(level);
+			if (state.saver)
+				state.path.push_back(*step);
+
+			if (!assign(pos, guess, step->reason))
+			{
+				conflict = conflictReason(state);
+				return false;
+			}
+			return search(state, level, conflict);
+		}
+	}
+	else
+	{
+		// find position to brute force
+		while (grid[pos] != cell_state::unknown)
+			++pos;
+	}
+
+	const reason_set level_bit = reason_set(1) << std::min(level, reason_bits - 1);
+
+	state.decisions.resize(level + 1);
+	state.decisions[level] = {{pos, guess}, next_stamp};
+
+	const auto path_size = state.path.size();
+	if (state.saver)
+		state.path.push_back({{pos, guess == cell_state::filled}, true, 0});
+
+#ifdef CPUZZLE_TRACE
+	if (tracer)
+	{
+		tracer->instant("guess", {{"level", level},
+		                          {"row", pos / numcols},
+		                          {"column", pos % numcols},
+		                          {"filled", guess == cell_state::filled}});
+	}
+#endif
+
+	if (!state.reserveCopy())
+		return false;
+
+	// The copy is only needed for the first guess, so it is dropped before
+	// trying the second.
+	bool found = false;
+	{
+		nonagram copy(*this);
+
+#ifdef CPUZZLE_DEBUG
+		std::cout << "Guessing " << (guess == cell_state::filled ? "filled" : "empty")
+				  << " at position " << pos << "(" << (pos / numrows) << "," << (pos % numrows)
+				  << ")\n";
+#endif
+
+		if (!copy.assign(pos, guess, level_bit))
+			conflict = copy.conflictReason(state);
+		else
+			found = copy.search(state, level + 1, conflict);
+
+		if (found)
+			std::swap(copy, *this);
+		else
+			// Carry on numbering assignments after those made in the copy.
+			next_stamp = copy.next_stamp;
+	}
+	state.releaseCopy();
+
+	if (found)
+		return true;
+
+	state.path.resize(path_size);
+
+	// The guess played no part in the failure, so neither value can succeed.
+	if (state.over_budget || !(conflict & level_bit))
+	{
+#ifdef CPUZZLE_TRACE
+		if (tracer)
+			tracer->instant("backjump", {{"level", level}});
+#endif
+		return false;
+	}
+
+#ifdef CPUZZLE_TRACE
+	if (tracer)
+		tracer->instant("backtrack", {{"level", level}});
+#endif
+
+	learn(state, conflict);
+
+	// What follows is no longer a guess at this level.
+	state.decisions.resize(level);
+
+	guess = (guess == cell_state::filled) ? cell_state::empty : cell_state::filled;
+
+#ifdef CPUZZLE_DEBUG
+	std::cout << "Guess at position " << pos << "(" << (pos / numrows) << "," << (pos % numrows)
+			  << ") was incorrect, trying " << (guess == cell_state::filled ? "filled" : "empty")
+			  << " instead\n";
+#endif
+
+	// No need to use the copy anymore, if this solves the puzzle the solution
+	// is already in place, if not, the puzzle is "junk" anyways.
+
+	// This value is no longer a guess, it follows from whatever the failure
+	// of the first one depended on.
+	const reason_set reason = (level < reason_bits - 1) ? (conflict & ~level_bit) : conflict;
+
+	if (state.saver)
+		state.path.push_back({{pos, guess == cell_state::filled}, false, reason});
+
+	if (!assign(pos, guess, reason))
+	{
+		conflict = conflictReason(state);
+		return false;
+	}
+
+	// Since this is the last attempt, let the result escalate.
+	return search(state, level, conflict);
+}
+
+bool nonagram::search_state::reserveCopy()
+{
+	if (memory_budget == 0)
+		return true;
+
+	if (memory_used->fetch_add(copy_bytes) + copy_bytes > memory_budget)
+	{
+		memory_used->fetch_sub(copy_bytes);
+		over_budget = true;
+		return false;
+	}
+	return true;
+}
+
+void nonagram::search_state::releaseCopy()
+{
+	if (memory_budget != 0)
+		memory_used->fetch_sub(copy_bytes);
+}
+
+void nonagram::search_state::addNogood(nogood ng)
+{
+	const auto index = static_cast<unsigned>(nogoods.size());
+	for (const auto& lit : ng)
+	{
+		const auto assignment = holdingIndex(lit.pos, lit.value);
+		if (assignment >= holding.size())
+			holding.resize(assignment + 1);
+		holding[assignment].push_back(index);
+	}
+
+	nogoods.push_back(std::move(ng));
+	checked_in.push_back(0);
+}
+
+void nonagram::search_state::saveProgress()
+{
+	checkpoint::part progress;
+	progress.nodes = nodes;
+	progress.path = path;
+	for (const auto& ng : nogoods)
+	{
+		auto& saved = progress.nogoods.emplace_back();
+		for (const auto& lit : ng)
+			saved.push_back({lit.pos, lit.value == cell_state::filled});
+	}
+
+	saver->update(which, std::move(progress));
+	next_save = std::chrono::steady_clock::now() + saver->saveInterval();
+}
+
+/*-------------------------------------------------------------
+Takes the next step of the branch being resumed, if any. Without
+the nogoods, which only come into use once the whole branch has
+been taken again, line solving knows no more cells than it did
+when the branch was saved, so each step should land on an unknown
+cell. If one does not, the rest of the branch is dropped and the
+search carries on from here.
+-------------------------------------------------------------*/
+
+const checkpoint::step* nonagram::nextReplayStep(search_state& state) const
+{
+	if (state.replayed == state.replay.size())
+		return nullptr;
+
+	const auto& step = state.replay[state.replayed++];
+	const bool usable = grid[step.cell.pos] == cell_state::unknown;
+	if (!usable)
+		state.replayed = state.replay.size();
+
+	if (state.replayed == state.replay.size())
+	{
+		for (auto& ng : state.replay_nogoods)
+			state.addNogood(std::move(ng));
+		state.replay_nogoods.clear();
+	}
+	return usable ? &step : nullptr;
+}
+
+std::size_t nonagram::memoryUsage() const
+{
+	std::size_t bytes = sizeof(*this) + grid.size() * sizeof(cell_state) +
+	                    stamps.size() * sizeof(unsigned) + antecedents.size() * sizeof(unsigned) +
+	                    reasons.size() * sizeof(reason_set) + conflicts.size() * sizeof(unsigned) +
+	                    lines.size() * sizeof(std::optional<line>);
+
+	for (const auto& lin : lines)
+	{
+		if (!lin)
+			continue;
+
+		bytes += lin->fills.size() * sizeof(line::fill);
+		for (const auto& fl : lin->fills)
+			bytes += fl.candidates.memoryUsage();
+	}
+	return bytes;
+}
+
+/*-------------------------------------------------------------
+Groups the unsolved lines so that no unknown cell is shared by two
+groups, which means guesses in one group cannot affect another.
+Sets the group of each line, no_line for solved lines, and returns
+the number of groups.
+-------------------------------------------------------------*/
+
+unsigned nonagram::lineComponents(std::vector<unsigned>& component) const
+{
+	// Union-find over lines, joining the row and column of each unknown cell.
+	std::vector<unsigned> parent(lines.size());
+	std::iota(parent.begin(), parent.end(), 0u);
+
+	const auto find = [&](unsigned lin)
+	{
+		while (parent[lin] != lin)
+			lin = parent[lin] = parent[parent[lin]];
+		return lin;
+	};
+
+	for (unsigned pos = 0; pos < grid.size(); ++pos)
+	{
+		if (grid[pos] == cell_state::unknown)
+			parent[find(pos / numcols)] = find(numrows + pos % numcols);
+	}
+
+	component.assign(lines.size(), no_line);
+	std::vector<unsigned> label(lines.size(), no_line);
+	unsigned count = 0;
+	for (unsigned lin = 0; lin < lines.size(); ++lin)
+	{
+		if (!lines[lin])
+			continue;
+
+		auto& root = label[find(lin)];
+		if (root == no_line)
+			root = count++;
+		component[lin] = root;
+	}
+	return count;
+}
+
+/*-------------------------------------------------------------
+Searches for a solution to the lines in group 'which' alone, on a
+copy of the puzzle in which every other line is taken as solved.
+On success, writes the values found for the group's cells into
+'solution'. Only reads the puzzle, so groups can be searched in
+parallel.
+-------------------------------------------------------------*/
+
+bool nonagram::searchComponent(std::span<const unsigned> component, unsigned which,
+                               std::span<cell_state> solution, search_state& state) const
+{
+	if (!state.reserveCopy())
+		return false;
+
+	nonagram part(*this);
+
+	// The other groups' cells are never looked at again, but must not be
+	// picked for guessing either.
+	for (unsigned pos = 0; pos < grid.size(); ++pos)
+	{
+		if (grid[pos] == cell_state::unknown && component[pos / numcols] != which)
+			part.grid[pos] = cell_state::empty;
+	}
+
+	for (unsigned lin = 0; lin < lines.size(); ++lin)
+	{
+		if (!part.lines[lin])
+			continue;
+
+		if (component[lin] == which)
+		{
+			part.lines[lin]->needs_line_solving = true;
+		}
+		else
+		{
+			part.lines[lin].reset();
+			--part.lines_to_solve;
+		}
+	}
+
+	reason_set conflict;
+	const bool solved = part.search(state, 0, conflict);
+
+	if (solved)
+	{
+		checkpoint::part progress;
+		progress.nodes = state.nodes;
+		progress.solved = true;
+
+		for (unsigned pos = 0; pos < grid.size(); ++pos)
+		{
+			if (grid[pos] == cell_state::unknown && component[pos / numcols] == which)
+			{
+				solution[pos] = part.grid[pos];
+				progress.filled.push_back(part.grid[pos] == cell_state::filled);
+			}
+		}
+
+		// A whole part is worth saving straight away.
+		if (state.saver)
+			state.saver->update(which, std::move(progress), true);
+	}
+
+	state.releaseCopy();
+	return solved;
+}
+
+/*-------------------------------------------------------------
+Reads the checkpoint solve() is to resume from, given the group of
+each line and the number of unknown cells in each group. If there
+is none, or it is not for this puzzle as it stands after line
+solving, returns one with no progress on any group.
+-------------------------------------------------------------*/
+
+checkpoint nonagram::startingPoint(std::span<const unsigned> component,
+                                   std::span<const unsigned> sizes) const
+{
+	const auto fresh = [&]
+	{
+		checkpoint start;
+		start.rows = numrows;
+		start.hints = *hints;
+		start.parts.resize(sizes.size());
+		for (unsigned which = 0; which < sizes.size(); ++which)
+			start.parts[which].size = sizes[which];
+		return start;
+	};
+
+	checkpoint saved;
+	if (!checkpointing->resume || !saved.read(checkpointing->file) || saved.rows != numrows ||
+	    saved.hints != *hints || saved.parts.size() != sizes.size())
+	{
+		return fresh();
+	}
+
+	// Cells named by the file must be unknown cells of their group, which
+	// also keeps them within the grid.
+	const auto inPart = [&](unsigned pos, unsigned which)
+	{
+		return pos < grid.size() && grid[pos] == cell_state::unknown &&
+		       component[pos / numcols] == which;
+	};
+
+	for (unsigned which = 0; which < sizes.size(); ++which)
+	{
+		const auto& part = saved.parts[which];
+		if (part.size != sizes[which])
+			return fresh();
+
+		for (const auto& step : part.path)
+		{
+			if (!inPart(step.cell.pos, which))
+				return fresh();
+		}
+		for (const auto& ng : part.nogoods)
+		{
+			for (const auto& lit : ng)
+			{
+				if (!inPart(lit.pos, which))
+					return fresh();
+			}
+		}
+	}
+	return saved;
+}
+
+bool nonagram::solve()
+{
+	nodes_searched = 1;
+	search_depth = 0;
+	over_budget = false;
+	checkpoint_failed = false;
+
+	// Once the answer is known, however it was reached, a checkpoint left by an
+	// earlier run would only mislead a later one resuming from it.
+	const auto removeCheckpoint = [this]
+	{
+		if (checkpointing)
+		{
+			std::error_code ec;
+			std::filesystem::remove(checkpointing->file, ec);
+		}
+	};
+
+	if (!deduce())
+	{
+		removeCheckpoint();
+		return false;
+	}
+
+	if (isComplete())
+	{
+		removeCheckpoint();
+		return true;
+	}
+
+	std::vector<unsigned> component;
+	const unsigned count = lineComponents(component);
+
+	std::vector<unsigned> sizes(count, 0);
+	for (unsigned pos = 0; pos < grid.size(); ++pos)
+	{
+		if (grid[pos] == cell_state::unknown)
+			++sizes[component[pos / numcols]];
+	}
+
+	// Every copy of the puzzle is about the size of this one.
+	const std::size_t copy_bytes = (memory_budget != 0) ? memoryUsage() : 0;
+
+	std::atomic<std::size_t> memory_used = 0;
+	std::vector<search_state> states(count);
+	for (auto& state : states)
+	{
+		state.memory_used = &memory_used;
+		state.memory_budget = memory_budget;
+		state.copy_bytes = copy_bytes;
+	}
+
+	std::vector<cell_state> solution(grid);
+	std::vector<char> solved(count, false);
+
+	std::unique_ptr<checkpoint_writer> saver;
+	if (checkpointing)
+	{
+		auto start = startingPoint(component, sizes);
+		for (unsigned which = 0; which < count; ++which)
+		{
+			auto& part = start.parts[which];
+			auto& state = states[which];
+			state.nodes = part.nodes;
+
+			if (part.solved)
+			{
+				auto filled = part.filled.begin();
+				for (unsigned pos = 0; pos < grid.size(); ++pos)
+				{
+					if (grid[pos] == cell_state::unknown && component[pos / numcols] == which)
+						solution[pos] = *filled++ ? cell_state::filled : cell_state::empty;
+				}
+				solved[which] = true;
+				continue;
+			}
+
+			state.replay = part.path;
+			for (const auto& ng : part.nogoods)
+			{
+				auto& restored = state.replay_nogoods.emplace_back();
+				for (const auto& lit : ng)
+				{
+					restored.push_back(
+						{lit.pos, lit.filled ? cell_state::filled : cell_state::empty});
+				}
+			}
+		}
+
+		saver = std::make_unique<checkpoint_writer>(*checkpointing, std::move(start));
+		const auto first_save = std::chrono::steady_clock::now() + saver->saveInterval();
+		for (unsigned which = 0; which < count; ++which)
+		{
+			states[which].saver = saver.get();
+			states[which].which = which;
+			states[which].next_save = first_save;
+		}
+	}
+
+	// Groups too small to be worth a thread are searched on this one. The
+	// rest are handed out to as many threads as there are cores, or as
+	// setThreads() allows, so that no more copies of the puzzle are alive at
+	// once than are useful.
+	constexpr unsigned parallel_cells = 64;
+	std::atomic<unsigned> next_large = 0;
+
+	const auto work = [&]
+	{
+		for (unsigned which; (which = next_large++) < count;)
+		{
+			if (sizes[which] >= parallel_cells && !solved[which])
+				solved[which] = searchComponent(component, which, solution, states[which]);
+		}
+	};
+
+	unsigned large = 0;
+	for (const auto size : sizes)
+		large += (size >= parallel_cells);
+
+	{
+		const unsigned allowed = max_threads ? max_threads : std::thread::hardware_concurrency();
+		const unsigned threads = std::min(std::max(allowed, 1u), large);
+
+		std::vector<std::jthread> workers;
+		for (unsigned t = 1; t < threads; ++t)
+			workers.emplace_back(work);
+
+		for (unsigned which = 0; which < count; ++which)
+		{
+			if (sizes[which] < parallel_cells && !solved[which])
+				solved[which] = searchComponent(component, which, solution, states[which]);
+		}
+		work();
+	}
+
+	nodes_searched = 0;
+	for (const auto& state : states)
+	{
+		nodes_searched += state.nodes;
+		search_depth = std::max(search_depth, state.depth);
+		over_budget |= state.over_budget;
+	}
+	nodes_searched = std::max<std::uint64_t>(nodes_searched, 1);
+
+	// Running out of memory is the one way to stop that trying again, with a
+	// larger budget, would not repeat.
+	if (saver)
+	{
+		checkpoint_failed = saver->writeFailed();
+		if (!over_budget)
+			removeCheckpoint();
+	}
+
+	if (!std::ranges::all_of(solved, [](char s) { return s; }))
+		return false;
+
+	grid = std::move(solution);
+	std::ranges::fill(lines, std::nullopt);
+	lines_to_solve = 0;
+	return true;
+}
+
+/*-------------------------------------------------------------
+Tries both values of every unknown cell on a copy, line solving
+after each. If one value leads to a contradiction, the cell takes
+the other, until no cell changes. Counts the values tried in
+'probes'. Returns false if both values of a cell fail.
+-------------------------------------------------------------*/
+
+bool nonagram::probe(std::uint64_t& probes)
+{
+	for (bool changed = true; changed && !isComplete();)
+	{
+		changed = false;
+		for (unsigned pos = 0; pos < grid.size() && !isComplete(); ++pos)
+		{
+			for (const auto value : {cell_state::filled, cell_state::empty})
+			{
+				if (grid[pos] != cell_state::unknown)
+					break;
+
+				++probes;
+				nonagram copy(*this);
+				if (copy.assign(pos, value, 0) && copy.line_solve())
+					continue;
+
+				const auto other =
+					(value == cell_state::filled) ? cell_state::empty : cell_state::filled;
+				if (!assign(pos, other, 0) || !line_solve())
+					return false;
+				changed = true;
+			}
+		}
+	}
+	return true;
+}
+
+nonagram::rating nonagram::rate()
+{
+	rating result;
+
+	// The overlap rules alone do not check every hint, so a grid they
+	// complete only counts if it is an actual solution.
+	nonagram simple(*this);
+	simple.line_passes = simple.lines_solved = 0;
+	if (simple.isComplete() || simple.line_solve(true))
+	{
+		result.passes = simple.line_passes;
+		result.lines = simple.lines_solved;
+
+		if (simple.isComplete())
+		{
+			const auto filled = std::make_unique<bool[]>(grid.size());
+			for (unsigned pos = 0; pos < grid.size(); ++pos)
+				filled[pos] = (simple.grid[pos] == cell_state::filled);
+
+			if (setSolution({filled.get(), grid.size()}))
+			{
+				result.level = tier::overlap;
+				return result;
+			}
+		}
+	}
+
+	line_passes = lines_solved = 0;
+
+	const auto finish = [&](tier level)
+	{
+		result.level = level;
+		result.passes = line_passes;
+		result.lines = lines_solved;
+		return result;
+	};
+
+	if (!deduce())
+		return finish(tier::unsolvable);
+	if (isComplete())
+		return finish(tier::line_solving);
+
+	if (!probe(result.probes))
+		return finish(tier::unsolvable);
+	if (isComplete())
+		return finish(tier::probing);
+
+	const bool solved = solve();
+	result.nodes = nodes_searched;
+	result.depth = search_depth;
+	return finish(solved ? tier::search : tier::unsolvable);
+}
+
+bool nonagram::isComplete() const { return lines_to_solve == 0; }
+
+bool nonagram::setSolution(std::span<const bool> filled)
+{
+	std::vector<cell_state> solution(grid.size());
+	std::ranges::transform(filled, solution.begin(), [](bool f)
+	                       { return f ? cell_state::filled : cell_state::empty; });
+
+	std::vector<cell_state> cells;
+	for (unsigned lin = 0; lin < lines.size(); ++lin)
+	{
+		cells.clear();
+		for (const auto ref : lineCells(lin))
+		{
+			cells.push_back(solution[ref]);
+		}
+
+		if (!fits(cells, (*hints)[lin]))
+			return false;
+	}
+
+	grid = std::move(solution);
+	std::ranges::fill(lines, std::nullopt);
+	lines_to_solve = 0;
+	return true;
+}
+
+BMP_24 nonagram::bitmap() const
+{
+	BMP_24 soln(numrows, numcols);
+
+	unsigned pos = 0;
+	for (unsigned i = 0; i < numrows; ++i)
+	{
+		// The rows in a bitmap are flipped, so when writing,
+		// write to the opposite side.
+		unsigned rowNum = numrows - 1 - i;
+		for (unsigned j = 0; j < numcols; ++j)
+		{
+			if (grid[pos] == cell_state::filled)
+			{
+				soln(rowNum, j) = color_24_consts::black;
+			}
+			else if (grid[pos] == cell_state::unknown)
+			{
+				soln(rowNum, j) = color_24_consts::gray;
+			}
+			// base color is white
+
+			++pos;
+		}
+	}
+	return soln;
+}
+
+void nonagram::printGrid(std::ostream& stream) const
+{
+	unsigned pos = 0;
+	for (unsigned i = 0; i < numrows; ++i)
+	{
+		for (unsigned j = 0; j < numcols; ++j)
+		{
+			switch (grid[pos++])
+			{
+			case cell_state::unknown:
+				stream << '?';
+				break;
+			case cell_state::filled:
+				stream << 'X';
+				break;
+			case cell_state::empty:
+				stream << '.';
+				break;
+			}
+		}
+		stream << '\n';
+	}
 }
@@ -1,15 +1,28 @@
 #pragma once
 
 #include "bmp.hpp"
+#include "candidate_set.hpp"
+#include "checkpoint.hpp"
 #include "index_generator.hpp"
+#include "line_table.hpp"
 
-#include <deque>
+#ifdef CPUZZLE_TRACE
+#include "trace.hpp"
+#endif
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
 #include <iostream>
+#include <memory>
 #include <optional>
+#include <span>
+#include <unordered_map>
 #include <vector>
 
 class nonagram
 {
+  public:
 	enum class cell_state : int
 	{
 		unknown,
@@ -17,6 +30,66 @@ class nonagram
 		empty
 	};
 
+	// The weakest way of solving that is enough for a puzzle, easiest first.
+	enum class tier : int
+	{
+		// Marking the cells that every placement of a fill covers or misses.
+		overlap,
+		// Adding the rules that fit fills around filled cells and each other.
+		line_solving,
+		// Trying each value of a cell, and keeping the other if it leads to a
+		// contradiction by line solving alone.
+		probing,
+		search,
+		unsolvable
+	};
+
+	// Why a puzzle's hints cannot have a solution, as found by checkHints().
+	// Converts to true if no reason was found.
+	struct hint_check
+	{
+		enum class problem
+		{
+			none,
+			// A 0 in a hint list of more than one hint.
+			zero_hint,
+			// The line is shorter than its hints need.
+			overfull_line,
+			// The rows and the columns fill different numbers of cells.
+			unequal_totals,
+			// The line fills more cells than the lines crossing it can, or
+			// fewer than they must.
+			cross_count
+		};
+
+		problem what = problem::none;
+		bool is_row = false;
+		unsigned index = 0;
+
+		// Cells needed, against those available, or the bounds on them.
+		std::uint64_t count = 0, low = 0, high = 0;
+
+		explicit operator bool() const { return what == problem::none; }
+
+		friend std::ostream& operator<<(std::ostream& stream, const hint_check& check);
+	};
+
+	// How hard a puzzle was to solve, as found by rate().
+	struct rating
+	{
+		tier level = tier::unsolvable;
+
+		// Passes over the lines, and lines solved, by line solving up to the
+		// tier needed. Line solving on copies, while probing or searching, is
+		// not counted.
+		std::uint64_t passes = 0, lines = 0;
+
+		// Cells probed, search nodes visited and deepest guess level.
+		std::uint64_t probes = 0, nodes = 0;
+		unsigned depth = 0;
+	};
+
+  private:
 	struct line
 	{
 		const index_generator<> grid;
@@ -25,19 +98,23 @@ class nonagram
 		struct fill
 		{
 			unsigned length;
-			std::deque<unsigned> candidates;
+			candidate_set<> candidates;
 
 			fill(unsigned fl, unsigned start, unsigned end);
 		};
 		std::vector<fill> fills;
 
+		// Every way of filling in the line if it is short enough for
+		// line_table, empty otherwise.
+		std::span<const line_table::mask> arrangements;
+
 		bool needs_line_solving, is_row;
 
 		line(index_generator<>&& refs, const std::vector<unsigned>& hintList, bool is_r);
 	};
 
 	// Variables
-	unsigned numrows, numcols;
+	unsigned numrows = 0, numcols = 0;
 
 	// Layout of indexes:
 	// Row 0: 0 -> (numcols-1)
@@ -49,7 +126,128 @@ class nonagram
 	std::vector<std::optional<line>> lines;
 
 	// Keeps track of the number of lines left to solve.
-	unsigned lines_to_solve;
+	unsigned lines_to_solve = 0;
+
+	// Lines on which line solving found a contradiction.
+	std::vector<unsigned> conflicts;
+
+	// Hint lists of every line, rows then columns. Shared between copies, and
+	// null in a puzzle that was never read.
+	std::shared_ptr<const std::vector<std::vector<unsigned>>> hints;
+
+	// A set of search levels, one bit per level. Levels past the last bit
+	// all share it.
+	using reason_set = std::uint64_t;
+	constexpr static unsigned reason_bits = 64;
+
+	// Marks a cell whose reason is already known rather than to be explained
+	// by the line it was deduced in.
+	constexpr static unsigned no_line = ~0u;
+
+	// For each cell: the order in which it was assigned, the line whose
+	// solving deduced it, and the levels whose guesses its value depends on.
+	// The latter is only worked out when a conflict needs it.
+	std::vector<unsigned> stamps;
+	std::vector<unsigned> antecedents;
+	std::vector<reason_set> reasons;
+	unsigned next_stamp = 1;
+
+	// Assignments with stamps from this one on, and nogoods from this index
+	// on, are yet to be checked by applyNogoods().
+	unsigned nogoods_stamp = 0;
+	std::size_t nogoods_checked = 0;
+
+	// A cell assignment. A nogood is a set of them that cannot all hold.
+	struct literal
+	{
+		unsigned pos;
+		cell_state value;
+	};
+	using nogood = std::vector<literal>;
+
+	// A guess, and the stamp of the cell it was made on.
+	struct decision
+	{
+		literal guess;
+		unsigned stamp;
+	};
+
+	// State shared by every copy of the puzzle made during one solve().
+	struct search_state
+	{
+		// Guess made at each level of the current branch
+		std::vector<decision> decisions;
+
+		std::vector<nogood> nogoods;
+
+		// Indexes of the nogoods holding each assignment, two per cell, and
+		// the pass of applyNogoods() that last checked each nogood.
+		std::vector<std::vector<unsigned>> holding;
+		std::vector<unsigned> checked_in;
+		unsigned pass = 0;
+
+		void addNogood(nogood ng);
+
+		// Reasons worked out so far, by stamp. Stamps are never reused within
+		// a search, so these hold across branches.
+		std::unordered_map<unsigned, reason_set> explained;
+
+		// Line checks left for explaining the current conflict. On hard
+		// puzzles, a larger budget saves fewer nodes than it costs in time.
+		unsigned budget = 0;
+		constexpr static unsigned explain_budget = 16;
+
+		std::uint64_t nodes = 0;
+		unsigned depth = 0;
+
+		// Bytes of puzzle copies alive in every search sharing 'memory_used',
+		// the size of one, and the most allowed, 0 meaning no limit. Once a
+		// copy would go over, the search gives up.
+		std::atomic<std::size_t>* memory_used = nullptr;
+		std::size_t copy_bytes = 0, memory_budget = 0;
+		bool over_budget = false;
+
+		[[nodiscard]] bool reserveCopy();
+		void releaseCopy();
+
+		// Where the progress of part 'which' is reported, if anywhere, and
+		// when it next is.
+		checkpoint_writer* saver = nullptr;
+		unsigned which = 0;
+		std::chrono::steady_clock::time_point next_save;
+
+		// Steps of the current branch, only kept while reporting progress.
+		std::vector<checkpoint::step> path;
+
+		// Steps of a saved branch to take again before searching on, and the
+		// nogoods to start using once they have been.
+		std::vector<checkpoint::step> replay;
+		std::size_t replayed = 0;
+		std::vector<nogood> replay_nogoods;
+
+		void saveProgress();
+	};
+
+	std::uint64_t nodes_searched = 0;
+	unsigned search_depth = 0;
+
+	// Passes made over the lines by line_solve(), and lines it solved.
+	std::uint64_t line_passes = 0, lines_solved = 0;
+
+	std::size_t memory_budget = 0;
+	bool over_budget = false;
+
+	// Most threads solve() searches on, 0 meaning one per hardware thread.
+	unsigned max_threads = 0;
+
+	// Where solve() saves its progress, if anywhere. Shared between copies.
+	std::shared_ptr<const checkpoint_settings> checkpointing;
+	bool checkpoint_failed = false;
+
+#ifdef CPUZZLE_TRACE
+	// Where solving events are recorded, shared by copies made while searching.
+	trace* tracer = nullptr;
+#endif
 
 	// Methods related to input
 	void evaluateHintList(index_generator<>&& refs, const std::vector<unsigned>& hintList,
@@ -63,29 +261,156 @@ class nonagram
 #endif
 
 	// Methods related to solving
-	[[nodiscard]] bool markInRange(line& lin, unsigned start, unsigned end, cell_state value);
+	[[nodiscard]] bool markInRange(line& lin, unsigned start, unsigned end, cell_state value,
+	                               unsigned lin_index);
 
 	[[nodiscard]] bool performSingleCellRules(cell_state value, unsigned lin, unsigned idx);
 
 	[[nodiscard]] bool isComplete(const line& lin) const;
 
 	[[nodiscard]] bool removeIncompatible(line& lin);
-	[[nodiscard]] bool markConsistent(line& lin);
+	[[nodiscard]] bool markConsistent(line& lin, unsigned lin_index);
+	[[nodiscard]] bool markByOwners(line& lin, unsigned lin_index, bool& changed);
+	[[nodiscard]] bool markArrangements(line& lin, unsigned lin_index);
+
+	// Only applies the overlap rules if 'overlap_only' is set.
+	[[nodiscard]] bool line_solve(bool overlap_only = false);
+
+	[[nodiscard]] bool probe(std::uint64_t& probes);
+
+	// Methods related to searching
+	index_generator<> lineCells(unsigned lin) const;
+	static reason_set reasonBound(const search_state& state, unsigned stamp);
+	reason_set explainLine(search_state& state, unsigned lin, std::vector<cell_state>& cells,
+	                       unsigned fixed);
+	reason_set cellReason(search_state& state, unsigned pos);
+	reason_set conflictReason(search_state& state);
 
-	[[nodiscard]] bool line_solve();
+	[[nodiscard]] bool assign(unsigned pos, cell_state value, reason_set reason);
+	[[nodiscard]] bool applyNogoods(search_state& state, bool& changed, reason_set& conflict);
+	void learn(search_state& state, reason_set conflict) const;
+
+	[[nodiscard]] const checkpoint::step* nextReplayStep(search_state& state) const;
+	[[nodiscard]] bool search(search_state& state, unsigned level, reason_set& conflict);
+
+	unsigned lineComponents(std::vector<unsigned>& component) const;
+	[[nodiscard]] bool searchComponent(std::span<const unsigned> component, unsigned which,
+	                                   std::span<cell_state> solution,
+	                                   search_state& state) const;
+	checkpoint startingPoint(std::span<const unsigned> component,
+	                         std::span<const unsigned> sizes) const;
 
   public:
-	// Reads in a nonagram puzzle from an input stream.
+	nonagram() = default;
+
+	// Constructs a puzzle from its hint lists, rows top to bottom and then
+	// columns left to right. An empty hint list denotes an empty line. The
+	// hints must pass checkHints().
+	nonagram(std::span<const std::vector<unsigned>> rowHints,
+	         std::span<const std::vector<unsigned>> colHints);
+
+	// Reads in a nonagram puzzle from an input stream. Sets failbit, leaving CP
+	// as it was, if the input ends early, the grid is too large to index or the
+	// hints fail checkHints().
 	friend std::istream& operator>>(std::istream& stream, nonagram& CP);
 
-	// Solves the puzzle, or returns false if unsolvable.
+	// Reads only the hint lists of a puzzle, as operator>> does, for callers
+	// that solve it some other way.
+	static std::istream& readHints(std::istream& stream,
+	                               std::vector<std::vector<unsigned>>& rowHints,
+	                               std::vector<std::vector<unsigned>>& colHints);
+
+	// Looks for simple reasons a puzzle cannot be solved, in time linear in the
+	// number of hints and lines: a line too short for its hints, row and column
+	// hints that add up differently, and lines filling more or fewer cells than
+	// the lines crossing them allow, going by the overlap of each crossing
+	// line's fills alone. Passing does not mean the puzzle has a solution.
+	static hint_check checkHints(std::span<const std::vector<unsigned>> rowHints,
+	                             std::span<const std::vector<unsigned>> colHints);
+
+	// Applies line solving only, without guessing. Returns false if a
+	// contradiction was found, the grid then holds what was deduced up to it.
+	[[nodiscard]] bool deduce();
+
+	// Solves the puzzle, or returns false if unsolvable. Parts of the grid
+	// that share no unsolved line are searched separately, the larger ones
+	// on threads of their own.
 	[[nodiscard]] bool solve();
 
+	// Number of search nodes visited by the last call to solve().
+	std::uint64_t searchNodes() const { return nodes_searched; }
+
+	// Deepest level of guesses reached by the last call to solve().
+	unsigned searchDepth() const { return search_depth; }
+
+	// Solves the puzzle with ever stronger techniques, stopping at the first
+	// that is enough, and reports which one that was along with the effort
+	// spent. The puzzle is left solved unless the rating is unsolvable.
+	[[nodiscard]] rating rate();
+
+	// Limits the memory solve() may use for copies of the puzzle while
+	// searching, in bytes, 0 meaning no limit. If the limit is hit, solve()
+	// returns false and exceededMemoryBudget() returns true.
+	void setMemoryBudget(std::size_t bytes) { memory_budget = bytes; }
+	bool exceededMemoryBudget() const { return over_budget; }
+
+	// Limits the threads solve() searches separate parts on, this one
+	// included, 0 meaning one per hardware thread. Callers already solving
+	// several puzzles at once should share the hardware threads out.
+	void setThreads(unsigned threads) { max_threads = threads; }
+
+	// Makes solve() save its progress to 'settings.file' about once per
+	// 'settings.interval' while searching, and remove the file once done. If
+	// 'settings.resume' is set and the file holds progress on this same
+	// puzzle, solve() picks up from there rather than starting over.
+	void setCheckpoint(checkpoint_settings settings)
+	{
+		checkpointing = std::make_shared<const checkpoint_settings>(std::move(settings));
+	}
+
+	// Whether the last call to solve() failed to write a checkpoint.
+	bool checkpointFailed() const { return checkpoint_failed; }
+
+	// Approximate memory held by this puzzle, in bytes, not counting the
+	// line_table shared by every puzzle.
+	std::size_t memoryUsage() const;
+
+#ifdef CPUZZLE_TRACE
+	// Records line solving and search events to 'tr', which must outlive any
+	// solving done. Null stops recording.
+	void setTrace(trace* tr) { tracer = tr; }
+#endif
+
 	// Returns true if the puzzle is solved. If solve() returned true, this
 	// will also return true.
 	bool isComplete() const;
 
+	unsigned rows() const { return numrows; }
+	unsigned cols() const { return numcols; }
+
+	// Hint lists of every line, rows then columns.
+	std::span<const std::vector<unsigned>> hintLists() const
+	{
+		return hints ? std::span(*hints) : std::span<const std::vector<unsigned>>();
+	}
+
+	// Fills in the whole grid from a solution found elsewhere, true meaning
+	// filled, in row-major order. Returns false, leaving the puzzle as it was,
+	// if it does not match the hints.
+	[[nodiscard]] bool setSolution(std::span<const bool> filled);
+
+	// Read-only view of the cells in row-major order. The view is invalidated
+	// by any subsequent call to solve().
+	std::span<const cell_state> cells() const { return grid; }
+
+	// Lines found contradictory by the last call to deduce(). Indexes below
+	// rows() are rows, the rest are columns offset by rows().
+	std::span<const unsigned> conflictingLines() const { return conflicts; }
+
+	// Writes the grid as text, one row per line: 'X' filled, '.' empty, '?' unknown.
+	void printGrid(std::ostream& stream) const;
+
 	// Creates a bitmap of the solution to this puzzle.
-	// Assumes the puzzle is solved.
+	// Unknown cells, if any, are rendered gray.
 	BMP_24 bitmap() const;
 };
@@ -0,0 +1,61 @@
+#include "nonagram_c.h"
+
+#include "nonagram.hpp"
+
+#include <new>
+#include <vector>
+
+struct nonagram_handle
+{
+	nonagram puzzle;
+
+	// The cells as the C enum values, copied from the puzzle whenever it
+	// changes, as cell_state cannot be read through an int pointer.
+	std::vector<int> cells;
+
+	void copyCells()
+	{
+		const auto grid = puzzle.cells();
+		cells.resize(grid.size());
+		for (std::size_t pos = 0; pos < grid.size(); ++pos)
+			cells[pos] = static_cast<int>(grid[pos]);
+	}
+};
+
+static_assert(static_cast<int>(nonagram::cell_state::unknown) == NONAGRAM_UNKNOWN);
+static_assert(static_cast<int>(nonagram::cell_state::filled) == NONAGRAM_FILLED);
+static_assert(static_cast<int>(nonagram::cell_state::empty) == NONAGRAM_EMPTY);
+
+nonagram_handle* nonagram_create(unsigned numrows, unsigned numcols, const unsigned* hints,
+                                 const unsigned* lengths)
+{
+	std::vector<std::vector<unsigned>> hintLists(numrows + numcols);
+
+	for (auto& hintList : hintLists)
+	{
+		hintList.assign(hints, hints + *lengths);
+		hints += *lengths++;
+	}
+
+	const std::span<const std::vector<unsigned>> all(hintLists);
+
+	if (!nonagram::checkHints(all.first(numrows), all.last(numcols)))
+		return nullptr;
+
+	auto* handle =
+		new (std::nothrow) nonagram_handle{nonagram(all.first(numrows), all.last(numcols)), {}};
+	if (handle)
+		handle->copyCells();
+	return handle;
+}
+
+void nonagram_destroy(nonagram_handle* handle) { delete handle; }
+
+int nonagram_solve(nonagram_handle* handle)
+{
+	const bool solved = handle->puzzle.solve();
+	handle->copyCells();
+	return solved ? 1 : 0;
+}
+
+const int* nonagram_cells(const nonagram_handle* handle) { return handle->cells.data(); }
@@ -0,0 +1,41 @@
+#pragma once
+
+/*
+C interface to the nonagram solver, for callers that cannot use the C++ API.
+
+Hints are passed flattened: hints holds every hint of every line back to back,
+rows top to bottom and then columns left to right, and lengths holds the number
+of hints belonging to each of those lines (0 for an empty line).
+*/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct nonagram_handle nonagram_handle;
+
+/* Cell values, matching nonagram::cell_state. */
+enum
+{
+	NONAGRAM_UNKNOWN = 0,
+	NONAGRAM_FILLED = 1,
+	NONAGRAM_EMPTY = 2
+};
+
+/* Creates a puzzle, or returns NULL on allocation failure or if the hints
+   plainly have no solution (see nonagram::checkHints). */
+nonagram_handle* nonagram_create(unsigned numrows, unsigned numcols, const unsigned* hints,
+                                 const unsigned* lengths);
+
+void nonagram_destroy(nonagram_handle* handle);
+
+/* Solves the puzzle, returns 1 on success and 0 if unsolvable. */
+int nonagram_solve(nonagram_handle* handle);
+
+/* Returns the numrows * numcols cells in row-major order. The pointer is owned
+   by the handle and is invalidated by the next call to nonagram_solve. */
+const int* nonagram_cells(const nonagram_handle* handle);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,19 @@
+#pragma once
+
+/*
+Reports the most memory the process has held in RAM at once (its peak
+resident set size), in bytes.
+*/
+
+#include <cstddef>
+
+#include <sys/resource.h>
+
+inline std::size_t peakMemory()
+{
+	rusage usage{};
+	getrusage(RUSAGE_SELF, &usage);
+
+	// Linux reports this in kilobytes.
+	return static_cast<std::size_t>(usage.ru_maxrss) * 1024;
+}
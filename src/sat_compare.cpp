@@ -0,0 +1,113 @@
+/*
+Solves every puzzle in a folder both with nonagram::solve() and with the
+built-in SAT solver, and reports the time each took and whether they agree.
+A puzzle can have more than one solution, so the two grids are each checked
+against the hints rather than against each other. If a second folder is
+given, the CNF encoding of each puzzle is also written there in DIMACS
+format.
+*/
+
+#include "sat_encoding.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <vector>
+
+namespace stdfs = std::filesystem;
+
+void parseArgs(int argc, const char* argv[])
+{
+	if (argc < 2 || 3 < argc)
+	{
+		std::cerr << "usage: " << argv[0] << " infolder [cnffolder]\n";
+		exit(1);
+	}
+}
+
+/*-------------------------------------------------
+Returns true if the grid of solved satisfies the
+hints of unsolved, which must be the same puzzle.
+-------------------------------------------------*/
+
+static bool satisfiesHints(const nonagram& unsolved, const nonagram& solved)
+{
+	const auto cells = solved.cells();
+
+	// std::vector<bool> is packed, so it cannot be viewed as a span.
+	const auto filled = std::make_unique<bool[]>(cells.size());
+	for (std::size_t pos = 0; pos < cells.size(); ++pos)
+		filled[pos] = cells[pos] == nonagram::cell_state::filled;
+
+	nonagram check(unsolved);
+	return check.setSolution({filled.get(), cells.size()});
+}
+
+int main(int argc, const char* argv[])
+{
+	parseArgs(argc, argv);
+	stdfs::path infolder(argv[1]);
+
+	if (argc == 3)
+		stdfs::create_directories(argv[2]);
+
+	std::vector<stdfs::path> infiles;
+	for (const auto& infile : stdfs::directory_iterator(infolder))
+	{
+		if (!infile.is_directory())
+			infiles.push_back(infile.path());
+	}
+	std::ranges::sort(infiles);
+
+	std::cout << std::left
+			  << "native (s)  "
+				 "sat (s)     "
+				 "result      "
+				 "input file\n";
+
+	for (const auto& infile : infiles)
+	{
+		nonagram native;
+		{
+			std::ifstream ifs(infile);
+
+			if (!ifs.is_open() || !(ifs >> native))
+			{
+				std::cout << infile << " input error\n";
+				continue;
+			}
+		}
+
+		if (argc == 3)
+		{
+			std::ofstream(stdfs::path(argv[2]) / infile.filename().replace_extension(".cnf"))
+				<< encode(native);
+		}
+
+		const nonagram unsolved(native);
+		nonagram sat(native);
+
+		const auto start = std::chrono::steady_clock::now();
+		const bool native_solved = native.solve();
+		const auto native_done = std::chrono::steady_clock::now();
+		const bool sat_solved = solveWithSat(sat);
+		const auto sat_done = std::chrono::steady_clock::now();
+
+		const char* result = "agree";
+		if (native_solved != sat_solved)
+			result = "DISAGREE";
+		else if (!native_solved)
+			result = "unsolvable";
+		else if (!satisfiesHints(unsolved, native) || !satisfiesHints(unsolved, sat))
+			result = "differ";
+
+		std::cout << std::setw(12)
+				  << std::chrono::duration<double, std::ratio<1>>(native_done - start).count()
+				  << std::setw(12)
+				  << std::chrono::duration<double, std::ratio<1>>(sat_done - native_done).count()
+				  << std::setw(12) << result << infile << '\n';
+	}
+}
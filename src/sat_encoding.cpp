@@ -0,0 +1,159 @@
+#include "sat_encoding.hpp"
+
+#include "sat_solver.hpp"
+
+#include <memory>
+#include <numeric>
+
+/*-------------------------------------------------------------
+Adds the clauses for one line, whose cells are the variables
+given by cells, with the given hint list.
+-------------------------------------------------------------*/
+
+static void encodeLine(cnf_formula& cnf, const index_generator<>& cells,
+                       const std::vector<unsigned>& hintList)
+{
+	const auto cellVar = [&](unsigned i) { return static_cast<int>(cells[i]) + 1; };
+	const unsigned n = cells.size();
+
+	if (hintList.empty())
+	{
+		for (unsigned i = 0; i < n; ++i)
+			cnf.clauses.push_back({-cellVar(i)});
+		return;
+	}
+
+	const unsigned sum = std::accumulate(hintList.begin(), hintList.end(), 0U);
+	const unsigned needed = sum + static_cast<unsigned>(hintList.size()) - 1;
+
+	// The hints do not fit, which an empty clause records.
+	if (needed > n)
+	{
+		cnf.clauses.emplace_back();
+		return;
+	}
+
+	const unsigned extraSpace = n - needed;
+
+	// starts[j][s] is the variable for fill j starting at its s-th candidate
+	// position, minPos[j] + s.
+	std::vector<std::vector<int>> starts(hintList.size());
+	std::vector<unsigned> minPos(hintList.size());
+
+	for (unsigned j = 0, pos = 0; j < hintList.size(); pos += hintList[j++] + 1)
+	{
+		minPos[j] = pos;
+		for (unsigned s = 0; s <= extraSpace; ++s)
+			starts[j].push_back(static_cast<int>(++cnf.num_vars));
+	}
+
+	// covering[i] holds the start variables whose fill covers cell i.
+	std::vector<std::vector<int>> covering(n);
+
+	for (unsigned j = 0; j < hintList.size(); ++j)
+	{
+		// At least one start.
+		cnf.clauses.push_back(starts[j]);
+
+		// At most one start, as a sequential counter: counter[s] is true if
+		// any of the first s + 1 starts is.
+		int prev_counter = 0;
+		for (unsigned s = 0; s < starts[j].size(); ++s)
+		{
+			const int start = starts[j][s];
+			if (prev_counter)
+				cnf.clauses.push_back({-start, -prev_counter});
+
+			if (s + 1 < starts[j].size())
+			{
+				const int counter = static_cast<int>(++cnf.num_vars);
+				cnf.clauses.push_back({-start, counter});
+				if (prev_counter)
+					cnf.clauses.push_back({-prev_counter, counter});
+				prev_counter = counter;
+			}
+		}
+
+		for (unsigned s = 0; s < starts[j].size(); ++s)
+		{
+			const unsigned first = minPos[j] + s;
+			const int start = starts[j][s];
+
+			// The fill covers its cells.
+			for (unsigned i = first; i < first + hintList[j]; ++i)
+			{
+				cnf.clauses.push_back({-start, cellVar(i)});
+				covering[i].push_back(start);
+			}
+
+			// The next fill starts past the cell after this one.
+			if (j + 1 < hintList.size())
+			{
+				std::vector<int> clause{-start};
+				for (unsigned t = 0; t < starts[j + 1].size(); ++t)
+				{
+					if (minPos[j + 1] + t > first + hintList[j])
+						clause.push_back(starts[j + 1][t]);
+				}
+				cnf.clauses.push_back(std::move(clause));
+			}
+		}
+	}
+
+	// A filled cell is covered by some fill.
+	for (unsigned i = 0; i < n; ++i)
+	{
+		std::vector<int> clause{-cellVar(i)};
+		clause.insert(clause.end(), covering[i].begin(), covering[i].end());
+		cnf.clauses.push_back(std::move(clause));
+	}
+}
+
+cnf_formula encode(const nonagram& puzzle)
+{
+	const unsigned numrows = puzzle.rows(), numcols = puzzle.cols();
+	const auto hintLists = puzzle.hintLists();
+
+	cnf_formula cnf;
+	cnf.num_vars = numrows * numcols;
+
+	for (unsigned i = 0; i < numrows; ++i)
+		encodeLine(cnf, index_generator(numcols * i, 1u, numcols), hintLists[i]);
+
+	for (unsigned i = 0; i < numcols; ++i)
+		encodeLine(cnf, index_generator(i, numcols, numrows), hintLists[numrows + i]);
+
+	return cnf;
+}
+
+std::ostream& operator<<(std::ostream& out, const cnf_formula& cnf)
+{
+	out << "p cnf " << cnf.num_vars << ' ' << cnf.clauses.size() << '\n';
+	for (const auto& clause : cnf.clauses)
+	{
+		for (const int lit : clause)
+			out << lit << ' ';
+		out << "0\n";
+	}
+	return out;
+}
+
+bool solveWithSat(nonagram& puzzle)
+{
+	const auto cnf = encode(puzzle);
+
+	sat_solver solver(cnf.num_vars);
+	for (const auto& clause : cnf.clauses)
+		solver.addClause(clause);
+
+	if (!solver.solve())
+		return false;
+
+	// std::vector<bool> is packed, so it cannot be viewed as a span.
+	const unsigned numcells = puzzle.rows() * puzzle.cols();
+	const auto filled = std::make_unique<bool[]>(numcells);
+	for (unsigned var = 1; var <= numcells; ++var)
+		filled[var - 1] = solver.modelValue(var);
+
+	return puzzle.setSolution({filled.get(), numcells});
+}
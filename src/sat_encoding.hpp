@@ -0,0 +1,33 @@
+#pragma once
+
+/*
+Encodes a nonagram as a boolean formula in conjunctive normal form, so it can
+be handed to a SAT solver.
+
+Variables 1 to rows * cols are the cells in row-major order, true if filled.
+After them, each fill of each line gets one variable per candidate starting
+position, constrained to exactly one true (at-most-one by a sequential
+counter), and to start after the previous fill ends. A cell is filled exactly
+when some fill of its row, and some fill of its column, covers it.
+*/
+
+#include "nonagram.hpp"
+
+#include <ostream>
+#include <vector>
+
+// Clauses use DIMACS numbering: variables from 1, negative literals negated.
+struct cnf_formula
+{
+	unsigned num_vars = 0;
+	std::vector<std::vector<int>> clauses;
+};
+
+cnf_formula encode(const nonagram& puzzle);
+
+// Writes the formula in DIMACS CNF format.
+std::ostream& operator<<(std::ostream& out, const cnf_formula& cnf);
+
+// Solves the puzzle with the built-in SAT solver instead of
+// nonagram::solve(). Returns false if unsolvable.
+[[nodiscard]] bool solveWithSat(nonagram& puzzle);
@@ -0,0 +1,372 @@
+#include "sat_solver.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+
+sat_solver::sat_solver(unsigned num_vars)
+	: assigns(num_vars, 0), levels(num_vars, 0), reasons(num_vars, no_reason),
+	  polarity(num_vars, true), seen(num_vars, false), watchers(2 * num_vars),
+	  activity(num_vars, 0), heap_index(num_vars, no_reason)
+{
+	heap.reserve(num_vars);
+	for (unsigned v = 0; v < num_vars; ++v)
+	{
+		heapInsert(v);
+	}
+}
+
+sat_solver::literal sat_solver::fromDimacs(int lit)
+{
+	return 2 * (static_cast<unsigned>(std::abs(lit)) - 1) + (lit < 0);
+}
+
+// Returns +1 if l is true, -1 if false, 0 if unassigned.
+int sat_solver::value(literal l) const
+{
+	const int v = assigns[l / 2];
+	return (l & 1) ? -v : v;
+}
+
+void sat_solver::enqueue(literal l, unsigned reason)
+{
+	const unsigned var = l / 2;
+	assigns[var] = (l & 1) ? -1 : 1;
+	levels[var] = decisionLevel();
+	reasons[var] = reason;
+	trail.push_back(l);
+}
+
+void sat_solver::watch(unsigned ci)
+{
+	watchers[clauses[ci][0]].push_back(ci);
+	watchers[clauses[ci][1]].push_back(ci);
+}
+
+void sat_solver::addClause(std::span<const int> lits)
+{
+	if (!ok)
+		return;
+
+	// Drop literals already false and clauses already satisfied; everything
+	// assigned at this point is assigned for good.
+	std::vector<literal> clause;
+	for (const int lit : lits)
+	{
+		const literal l = fromDimacs(lit);
+		const int val = value(l);
+
+		if (val > 0 || std::ranges::find(clause, l ^ 1) != clause.end())
+			return;
+
+		if (val == 0 && std::ranges::find(clause, l) == clause.end())
+			clause.push_back(l);
+	}
+
+	if (clause.empty())
+	{
+		ok = false;
+	}
+	else if (clause.size() == 1)
+	{
+		enqueue(clause[0], no_reason);
+		ok = (propagate() == no_reason);
+	}
+	else
+	{
+		clauses.push_back(std::move(clause));
+		watch(static_cast<unsigned>(clauses.size() - 1));
+	}
+}
+
+/*---------------------------------------------------------------
+Propagates every assignment on the trail not yet propagated.
+Returns the index of a clause with every literal false, or
+no_reason if there is none.
+---------------------------------------------------------------*/
+
+unsigned sat_solver::propagate()
+{
+	while (propagated < trail.size())
+	{
+		const literal falsified = trail[propagated++] ^ 1;
+		auto& ws = watchers[falsified];
+
+		std::size_t keep = 0;
+		for (std::size_t i = 0; i < ws.size(); ++i)
+		{
+			const unsigned ci = ws[i];
+			auto& clause = clauses[ci];
+
+			// Keep the falsified literal in the second slot.
+			if (clause[0] == falsified)
+				std::swap(clause[0], clause[1]);
+
+			if (value(clause[0]) > 0)
+			{
+				ws[keep++] = ci;
+				continue;
+			}
+
+			// Look for another literal to watch.
+			bool moved = false;
+			for (std::size_t k = 2; k < clause.size(); ++k)
+			{
+				if (value(clause[k]) >= 0)
+				{
+					std::swap(clause[1], clause[k]);
+					watchers[clause[1]].push_back(ci);
+					moved = true;
+					break;
+				}
+			}
+			if (moved)
+				continue;
+
+			ws[keep++] = ci;
+
+			if (value(clause[0]) < 0)
+			{
+				// Conflict, keep the remaining watches.
+				while (++i < ws.size())
+					ws[keep++] = ws[i];
+				ws.resize(keep);
+				return ci;
+			}
+
+			enqueue(clause[0], ci);
+		}
+		ws.resize(keep);
+	}
+	return no_reason;
+}
+
+/*---------------------------------------------------------------
+Derives a clause from a conflict that has exactly one literal
+at the current decision level (the first unique implication
+point), which is put first. Sets backtrack_level to the level
+at which that literal becomes implied.
+---------------------------------------------------------------*/
+
+void sat_solver::analyze(unsigned conflict, std::vector<literal>& learnt,
+                         unsigned& backtrack_level)
+{
+	learnt.assign(1, 0);
+
+	unsigned pending = 0;
+	literal implied = 0;
+	bool first = true;
+	std::size_t index = trail.size();
+
+	do
+	{
+		const auto& clause = clauses[conflict];
+
+		// The first literal of a reason clause is the one it implied.
+		for (std::size_t k = first ? 0 : 1; k < clause.size(); ++k)
+		{
+			const unsigned var = clause[k] / 2;
+			if (!seen[var] && levels[var] > 0)
+			{
+				seen[var] = true;
+				bump(var);
+
+				if (levels[var] == decisionLevel())
+					++pending;
+				else
+					learnt.push_back(clause[k]);
+			}
+		}
+
+		while (!seen[trail[--index] / 2])
+			;
+
+		implied = trail[index];
+		conflict = reasons[implied / 2];
+		seen[implied / 2] = false;
+		first = false;
+	} while (--pending > 0);
+
+	learnt[0] = implied ^ 1;
+
+	for (std::size_t k = 1; k < learnt.size(); ++k)
+		seen[learnt[k] / 2] = false;
+
+	backtrack_level = 0;
+	for (std::size_t k = 1; k < learnt.size(); ++k)
+	{
+		if (levels[learnt[k] / 2] > backtrack_level)
+		{
+			backtrack_level = levels[learnt[k] / 2];
+			std::swap(learnt[1], learnt[k]);
+		}
+	}
+}
+
+void sat_solver::cancelUntil(unsigned level)
+{
+	if (decisionLevel() <= level)
+		return;
+
+	for (std::size_t i = trail.size(); i-- > trail_limits[level];)
+	{
+		const unsigned var = trail[i] / 2;
+		polarity[var] = (trail[i] & 1);
+		assigns[var] = 0;
+		reasons[var] = no_reason;
+		if (heap_index[var] == no_reason)
+			heapInsert(var);
+	}
+
+	trail.resize(trail_limits[level]);
+	trail_limits.resize(level);
+	propagated = static_cast<unsigned>(trail.size());
+}
+
+void sat_solver::bump(unsigned var)
+{
+	activity[var] += activity_inc;
+
+	// Rescale everything before the values overflow.
+	if (activity[var] > 1e100)
+	{
+		for (auto& act : activity)
+			act *= 1e-100;
+		activity_inc *= 1e-100;
+	}
+
+	if (heap_index[var] != no_reason)
+		heapUp(heap_index[var]);
+}
+
+void sat_solver::heapUp(unsigned pos)
+{
+	const unsigned var = heap[pos];
+	while (pos > 0 && activity[heap[(pos - 1) / 2]] < activity[var])
+	{
+		heap[pos] = heap[(pos - 1) / 2];
+		heap_index[heap[pos]] = pos;
+		pos = (pos - 1) / 2;
+	}
+	heap[pos] = var;
+	heap_index[var] = pos;
+}
+
+void sat_solver::heapDown(unsigned pos)
+{
+	const unsigned var = heap[pos];
+	const auto size = static_cast<unsigned>(heap.size());
+	while (2 * pos + 1 < size)
+	{
+		unsigned child = 2 * pos + 1;
+		if (child + 1 < size && activity[heap[child + 1]] > activity[heap[child]])
+			++child;
+		if (activity[heap[child]] <= activity[var])
+			break;
+		heap[pos] = heap[child];
+		heap_index[heap[pos]] = pos;
+		pos = child;
+	}
+	heap[pos] = var;
+	heap_index[var] = pos;
+}
+
+void sat_solver::heapInsert(unsigned var)
+{
+	heap.push_back(var);
+	heapUp(static_cast<unsigned>(heap.size() - 1));
+}
+
+unsigned sat_solver::heapPop()
+{
+	const unsigned top = heap.front();
+	heap_index[top] = no_reason;
+
+	heap.front() = heap.back();
+	heap.pop_back();
+	if (!heap.empty())
+		heapDown(0);
+
+	return top;
+}
+
+// The i-th element (from 0) of the Luby sequence 1 1 2 1 1 2 4 1 1 2 ...
+static std::uint64_t luby(std::uint64_t i)
+{
+	std::uint64_t size = 1, seq = 0;
+	while (size < i + 1)
+	{
+		++seq;
+		size = 2 * size + 1;
+	}
+	while (size - 1 != i)
+	{
+		size = (size - 1) / 2;
+		--seq;
+		i %= size;
+	}
+	return std::uint64_t(1) << seq;
+}
+
+bool sat_solver::solve()
+{
+	if (!ok || propagate() != no_reason)
+		return ok = false;
+
+	std::vector<literal> learnt;
+	std::uint64_t restarts = 0, budget = 100 * luby(0);
+
+	while (true)
+	{
+		const unsigned conflict = propagate();
+
+		if (conflict != no_reason)
+		{
+			++num_conflicts;
+			if (decisionLevel() == 0)
+				return ok = false;
+
+			unsigned backtrack_level;
+			analyze(conflict, learnt, backtrack_level);
+			cancelUntil(backtrack_level);
+
+			if (learnt.size() == 1)
+			{
+				enqueue(learnt[0], no_reason);
+			}
+			else
+			{
+				clauses.push_back(learnt);
+				const auto ci = static_cast<unsigned>(clauses.size() - 1);
+				watch(ci);
+				enqueue(learnt[0], ci);
+			}
+
+			activity_inc /= 0.95;
+			if (budget > 0)
+				--budget;
+			continue;
+		}
+
+		if (budget == 0)
+		{
+			cancelUntil(0);
+			budget = 100 * luby(++restarts);
+		}
+
+		// Pick the most active unassigned variable.
+		unsigned var = no_reason;
+		while (!heap.empty())
+		{
+			var = heapPop();
+			if (assigns[var] == 0)
+				break;
+			var = no_reason;
+		}
+
+		if (var == no_reason)
+			return true;
+
+		trail_limits.push_back(static_cast<unsigned>(trail.size()));
+		enqueue(2 * var + polarity[var], no_reason);
+	}
+}
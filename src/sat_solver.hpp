@@ -0,0 +1,83 @@
+#pragma once
+
+/*
+A small CDCL SAT solver: two watched literals, first-UIP clause learning,
+VSIDS branching with phase saving, and Luby restarts. Variables are numbered
+from 1 and literals follow the DIMACS convention, a negative literal being the
+negation of its variable.
+*/
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+class sat_solver
+{
+	// Internally, variables are numbered from 0 and literal 2v is variable v,
+	// 2v+1 its negation.
+	using literal = unsigned;
+
+	constexpr static unsigned no_reason = ~0u;
+
+	// Per variable: +1 true, -1 false, 0 unassigned.
+	std::vector<std::int8_t> assigns;
+	std::vector<unsigned> levels;
+	std::vector<unsigned> reasons;
+	// Per variable: the phase to try next, true for false (phase saving).
+	std::vector<bool> polarity;
+
+	// Scratch space for analyze(), all false between calls.
+	std::vector<bool> seen;
+
+	std::vector<std::vector<literal>> clauses;
+
+	// For each literal, the clauses watching it, which are visited once it
+	// becomes false.
+	std::vector<std::vector<unsigned>> watchers;
+
+	std::vector<literal> trail;
+	std::vector<unsigned> trail_limits;
+	unsigned propagated = 0;
+
+	// VSIDS activity, and a max-heap of variables ordered by it.
+	std::vector<double> activity;
+	double activity_inc = 1;
+	std::vector<unsigned> heap;
+	std::vector<unsigned> heap_index;
+
+	// False once the clauses are known to be unsatisfiable.
+	bool ok = true;
+
+	std::uint64_t num_conflicts = 0;
+
+	static literal fromDimacs(int lit);
+
+	int value(literal l) const;
+	unsigned decisionLevel() const { return static_cast<unsigned>(trail_limits.size()); }
+
+	void enqueue(literal l, unsigned reason);
+	void watch(unsigned ci);
+	[[nodiscard]] unsigned propagate();
+	void analyze(unsigned conflict, std::vector<literal>& learnt, unsigned& backtrack_level);
+	void cancelUntil(unsigned level);
+
+	void bump(unsigned var);
+	void heapUp(unsigned pos);
+	void heapDown(unsigned pos);
+	void heapInsert(unsigned var);
+	unsigned heapPop();
+
+  public:
+	explicit sat_solver(unsigned num_vars);
+
+	// Adds a clause. Must be called before solve().
+	void addClause(std::span<const int> lits);
+
+	// Returns true if the clauses are satisfiable.
+	[[nodiscard]] bool solve();
+
+	// The value of a variable in the model found by solve().
+	bool modelValue(unsigned var) const { return assigns[var - 1] > 0; }
+
+	std::uint64_t conflicts() const { return num_conflicts; }
+};
@@ -0,0 +1,203 @@
+#include "solution_archive.hpp"
+
+#include <algorithm>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+constexpr std::string_view header = "NGARCHV1", trailer = "NGINDEX1";
+
+// Offset of the index and number of names, then the trailer itself.
+constexpr std::size_t trailer_size = 8 + 8 + trailer.size();
+
+void writeLittleEndian(std::string& out, std::uint64_t value, unsigned bytes)
+{
+	for (unsigned i = 0; i < bytes; ++i)
+		out += static_cast<char>((value >> (8 * i)) & 0xff);
+}
+
+std::uint64_t readLittleEndian(const unsigned char* in, unsigned bytes)
+{
+	std::uint64_t value = 0;
+	for (unsigned i = 0; i < bytes; ++i)
+		value |= std::uint64_t(in[i]) << (8 * i);
+	return value;
+}
+} // namespace
+
+archive_writer::archive_writer(const std::filesystem::path& file)
+	: out(file, std::ios::binary | std::ios::trunc)
+{
+	out << header;
+	offset = header.size();
+}
+
+bool archive_writer::good()
+{
+	std::lock_guard lock(mut);
+	return !!out;
+}
+
+std::optional<std::uint64_t> archive_writer::addGrid(unsigned rows, unsigned cols,
+                                                     std::span<const bool> filled)
+{
+	std::string bytes;
+	bytes.reserve(8 + (filled.size() + 7) / 8);
+	writeLittleEndian(bytes, rows, 4);
+	writeLittleEndian(bytes, cols, 4);
+
+	bytes.resize(8 + (filled.size() + 7) / 8, '\0');
+	for (std::size_t pos = 0; pos < filled.size(); ++pos)
+	{
+		if (filled[pos])
+			bytes[8 + pos / 8] = static_cast<char>(bytes[8 + pos / 8] | (1 << (pos % 8)));
+	}
+
+	std::lock_guard lock(mut);
+	if (!out.write(bytes.data(), static_cast<std::streamsize>(bytes.size())))
+		return std::nullopt;
+
+	const auto start = offset;
+	offset += bytes.size();
+	return start;
+}
+
+void archive_writer::addName(std::string name, std::uint64_t grid)
+{
+	std::lock_guard lock(mut);
+	names.emplace_back(std::move(name), grid);
+}
+
+bool archive_writer::finish()
+{
+	std::lock_guard lock(mut);
+	std::ranges::sort(names);
+
+	std::string bytes;
+	for (const auto& [name, grid] : names)
+	{
+		writeLittleEndian(bytes, name.size(), 4);
+		bytes += name;
+		writeLittleEndian(bytes, grid, 8);
+	}
+	writeLittleEndian(bytes, offset, 8);
+	writeLittleEndian(bytes, names.size(), 8);
+	bytes += trailer;
+
+	out.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+	out.close();
+	return !!out;
+}
+
+void archive_reader::close()
+{
+	if (data)
+		munmap(const_cast<unsigned char*>(data), size);
+	data = nullptr;
+	size = 0;
+	index.clear();
+}
+
+bool archive_reader::open(const std::filesystem::path& file)
+{
+	close();
+
+	const int fd = ::open(file.c_str(), O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	struct stat info{};
+	void* mapped = MAP_FAILED;
+	if (fstat(fd, &info) == 0 && info.st_size > 0)
+	{
+		mapped =
+			mmap(nullptr, static_cast<std::size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+	}
+	::close(fd);
+
+	if (mapped == MAP_FAILED)
+		return false;
+
+	data = static_cast<const unsigned char*>(mapped);
+	size = static_cast<std::size_t>(info.st_size);
+
+	const auto text = [&](std::size_t at, std::size_t length)
+	{ return std::string_view(reinterpret_cast<const char*>(data) + at, length); };
+
+	if (size < header.size() + trailer_size || text(0, header.size()) != header ||
+	    text(size - trailer.size(), trailer.size()) != trailer)
+	{
+		close();
+		return false;
+	}
+
+	const auto index_start = readLittleEndian(data + size - trailer_size, 8);
+	auto count = readLittleEndian(data + size - trailer_size + 8, 8);
+	const std::size_t index_end = size - trailer_size;
+
+	// Every entry is checked against the file size before it is read.
+	std::size_t at = index_start;
+	for (; count > 0 && at <= index_end && index_end - at >= 4; --count)
+	{
+		const auto length = readLittleEndian(data + at, 4);
+		if (index_end - at - 4 < length + 8)
+			break;
+
+		const auto start = readLittleEndian(data + at + 4 + length, 8);
+		index.emplace_back(text(at + 4, length), start);
+		at += 4 + length + 8;
+	}
+
+	if (count != 0 || at != index_end)
+	{
+		close();
+		return false;
+	}
+
+	std::ranges::sort(index);
+	return true;
+}
+
+std::optional<archive_reader::grid> archive_reader::find(std::string_view name) const
+{
+	const auto it = std::ranges::lower_bound(index, name, {}, &decltype(index)::value_type::first);
+	if (it == index.end() || it->first != name)
+		return std::nullopt;
+
+	// Grids lie between the header and the index.
+	const std::size_t at = it->second;
+	const std::size_t index_start = readLittleEndian(data + size - trailer_size, 8);
+	if (at < header.size() || at > index_start || index_start - at < 8)
+		return std::nullopt;
+
+	grid found;
+	found.rows = static_cast<unsigned>(readLittleEndian(data + at, 4));
+	found.cols = static_cast<unsigned>(readLittleEndian(data + at + 4, 4));
+
+	const std::size_t bytes = (std::size_t(found.rows) * found.cols + 7) / 8;
+	if (index_start - at - 8 < bytes)
+		return std::nullopt;
+
+	found.packed = {data + at + 8, bytes};
+	return found;
+}
+
+BMP_24 archive_reader::grid::bitmap() const
+{
+	BMP_24 soln(rows, cols);
+
+	// The rows in a bitmap are flipped.
+	for (unsigned row = 0; row < rows; ++row)
+	{
+		for (unsigned col = 0; col < cols; ++col)
+		{
+			if (filled(row, col))
+				soln(rows - 1 - row, col) = color_24_consts::black;
+		}
+	}
+	return soln;
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+/*
+A single file holding many solved grids under names of their own, so that a
+large batch of puzzles does not need a file, and an inode, per solution.
+
+The file starts with the 8 bytes "NGARCHV1", followed by the grids, each as
+its number of rows and of columns (32 bit little-endian) and then its cells
+in row-major order, 8 to a byte from the low bit, set meaning filled. After
+the grids comes the index: for each name in sorted order, its length (32
+bit), its bytes and the offset of its grid (64 bit). The file ends with the
+offset of the index and the number of names (64 bit each) and the 8 bytes
+"NGINDEX1". Names may share a grid.
+
+The index is only written once every grid has been, so an archive whose
+writer did not finish cannot be read.
+*/
+
+#include "bmp.hpp"
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Appends grids to a new archive. Safe to use from several threads.
+class archive_writer
+{
+	std::mutex mut;
+	std::ofstream out;
+	std::uint64_t offset = 0;
+	std::vector<std::pair<std::string, std::uint64_t>> names;
+
+  public:
+	// Creates the archive, replacing any file already there.
+	explicit archive_writer(const std::filesystem::path& file);
+
+	// Whether the archive could be written to so far.
+	bool good();
+
+	// Appends a grid, true meaning filled, in row-major order, and returns
+	// where it starts, or nothing if it could not be written.
+	std::optional<std::uint64_t> addGrid(unsigned rows, unsigned cols,
+	                                     std::span<const bool> filled);
+
+	// Names the grid starting at 'grid'.
+	void addName(std::string name, std::uint64_t grid);
+
+	// Writes the index. Returns false if anything could not be written. No
+	// more grids may be added afterwards.
+	bool finish();
+};
+
+// Looks up grids in a finished archive, mapped into memory.
+class archive_reader
+{
+	const unsigned char* data = nullptr;
+	std::size_t size = 0;
+
+	// Sorted by name.
+	std::vector<std::pair<std::string_view, std::uint64_t>> index;
+
+	void close();
+
+  public:
+	struct grid
+	{
+		unsigned rows, cols;
+		std::span<const unsigned char> packed;
+
+		bool filled(unsigned row, unsigned col) const
+		{
+			const std::size_t pos = std::size_t(row) * cols + col;
+			return (packed[pos / 8] >> (pos % 8)) & 1;
+		}
+
+		// Filled cells in black, the rest in white.
+		BMP_24 bitmap() const;
+	};
+
+	archive_reader() = default;
+	archive_reader(const archive_reader&) = delete;
+	archive_reader& operator=(const archive_reader&) = delete;
+	~archive_reader() { close(); }
+
+	// Maps an archive into memory. Returns false if it cannot be read, or is
+	// not a finished archive.
+	[[nodiscard]] bool open(const std::filesystem::path& file);
+
+	// Names in sorted order.
+	std::size_t names() const { return index.size(); }
+	std::string_view name(std::size_t i) const { return index[i].first; }
+
+	std::optional<grid> find(std::string_view name) const;
+};
@@ -0,0 +1,112 @@
+#include "solution_cache.hpp"
+
+#include <cstdint>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <system_error>
+
+#include <unistd.h>
+
+namespace stdfs = std::filesystem;
+
+solution_cache::solution_cache(stdfs::path dir) : folder(std::move(dir))
+{
+	stdfs::create_directories(folder);
+}
+
+std::string solution_cache::key(const nonagram& puzzle)
+{
+	std::ostringstream out;
+	out << puzzle.cols() << ' ' << puzzle.rows() << '\n';
+	for (const auto& hints : puzzle.hintLists())
+	{
+		for (std::size_t i = 0; i < hints.size(); ++i)
+		{
+			out << (i ? " " : "") << hints[i];
+		}
+		out << '\n';
+	}
+	return std::move(out).str();
+}
+
+// FNV-1a, which is plenty for telling apart files whose contents are checked anyway.
+stdfs::path solution_cache::entry(const std::string& key) const
+{
+	std::uint64_t hash = 0xcbf29ce484222325;
+	for (const char c : key)
+	{
+		hash ^= static_cast<unsigned char>(c);
+		hash *= 0x100000001b3;
+	}
+
+	std::ostringstream name;
+	name << std::hex;
+	name.width(16);
+	name.fill('0');
+	name << hash << ".sol";
+	return folder / std::move(name).str();
+}
+
+bool solution_cache::load(nonagram& puzzle, const std::string& key) const
+{
+	std::ifstream ifs(entry(key), std::ios::binary);
+	if (!ifs.is_open())
+		return false;
+
+	std::string stored(key.size(), '\0');
+	if (!ifs.read(stored.data(), static_cast<std::streamsize>(stored.size())) || stored != key)
+		return false;
+
+	const std::string packed{std::istreambuf_iterator<char>(ifs), {}};
+
+	const unsigned numcells = puzzle.rows() * puzzle.cols();
+	if (packed.size() != (numcells + 7) / 8)
+		return false;
+
+	// std::vector<bool> is packed, so it cannot be viewed as a span.
+	const auto filled = std::make_unique<bool[]>(numcells);
+	for (unsigned pos = 0; pos < numcells; ++pos)
+		filled[pos] = (static_cast<unsigned char>(packed[pos / 8]) >> (pos % 8)) & 1;
+
+	// This also guards against entries that were corrupted on disk.
+	return puzzle.setSolution({filled.get(), numcells});
+}
+
+bool solution_cache::store(const nonagram& puzzle, const std::string& key) const
+{
+	const auto cells = puzzle.cells();
+
+	std::string packed((cells.size() + 7) / 8, '\0');
+	for (std::size_t pos = 0; pos < cells.size(); ++pos)
+	{
+		if (cells[pos] == nonagram::cell_state::filled)
+			packed[pos / 8] = static_cast<char>(packed[pos / 8] | (1 << (pos % 8)));
+	}
+
+	// Write to a temporary file first, so that a reader never sees half an
+	// entry. Processes sharing the cache may store the same entry at once,
+	// so each writes under a name of its own.
+	char host[256] = {};
+	gethostname(host, sizeof(host) - 1);
+	const auto path = entry(key);
+	auto temp = path;
+	temp += '.' + std::string(host) + '.' + std::to_string(getpid()) + ".tmp";
+	{
+		std::ofstream ofs(temp, std::ios::binary);
+		ofs << key << packed;
+		ofs.close();
+		if (!ofs)
+		{
+			std::error_code ec;
+			stdfs::remove(temp, ec);
+			return false;
+		}
+	}
+
+	std::error_code ec;
+	stdfs::rename(temp, path, ec);
+	return !ec;
+}
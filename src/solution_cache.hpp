@@ -0,0 +1,35 @@
+#pragma once
+
+/*
+An on-disk cache of solved puzzles, addressed by the content of their hints.
+
+Each entry is a file named after a 64 bit hash of the puzzle's normalized
+hints (its dimensions and hint lists, independent of how the input file was
+laid out). It holds the normalized hints themselves, so that hash collisions
+are detected, followed by the solution packed 8 cells to a byte.
+*/
+
+#include "nonagram.hpp"
+
+#include <filesystem>
+#include <string>
+
+class solution_cache
+{
+	std::filesystem::path folder;
+
+	std::filesystem::path entry(const std::string& key) const;
+
+  public:
+	explicit solution_cache(std::filesystem::path dir);
+
+	// The normalized hints of a puzzle, equal for puzzles with the same hints.
+	static std::string key(const nonagram& puzzle);
+
+	// Fills in the puzzle from a cached solution, if there is one that
+	// matches. 'key' must be key(puzzle).
+	[[nodiscard]] bool load(nonagram& puzzle, const std::string& key) const;
+
+	// Adds a solved puzzle to the cache. Returns false if it could not be written.
+	bool store(const nonagram& puzzle, const std::string& key) const;
+};
@@ -18,39 +18,121 @@ column 2 clues
 column k clues
 */
 
+#include "color_nonagram.hpp"
 #include "nonagram.hpp"
+#include "peak_memory.hpp"
 
+#include <chrono>
+#include <cstdlib>
 #include <filesystem>
 #include <fstream>
+#include <span>
 #include <string>
+#include <string_view>
+#include <vector>
 
-void parseArgs(int argc, char* argv[])
+struct options
 {
-	if (argc < 2 || 3 < argc)
+	const char* infile = nullptr;
+	const char* outfile = nullptr;
+
+	// In bytes, 0 meaning no limit.
+	std::size_t memory_budget = 0;
+
+	// Save progress every so many seconds, 0 meaning never.
+	unsigned checkpoint = 0;
+	bool resume = false;
+};
+
+options parseArgs(int argc, char* argv[])
+{
+	options opts;
+	std::vector<const char*> positional;
+
+	for (int i = 1; i < argc; ++i)
 	{
-		std::cerr << "usage: " << argv[0] << " infile [outfile]\n";
+		const std::string_view arg = argv[i];
+		if (arg == "--memory" && i + 1 < argc)
+			opts.memory_budget = std::strtoull(argv[++i], nullptr, 10) << 20;
+		else if (arg == "--checkpoint" && i + 1 < argc)
+			opts.checkpoint = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 10));
+		else if (arg == "--resume")
+			opts.resume = true;
+		else
+			positional.push_back(argv[i]);
+	}
+
+	if (positional.size() < 1 || 2 < positional.size())
+	{
+		std::cerr << "usage: " << argv[0]
+				  << " [--memory MB] [--checkpoint seconds] [--resume] infile [outfile]\n";
 		exit(1);
 	}
+
+	// Resuming implies saving further progress too.
+	if (opts.resume && opts.checkpoint == 0)
+		opts.checkpoint = 60;
+
+	opts.infile = positional[0];
+	if (positional.size() == 2)
+		opts.outfile = positional[1];
+
+	return opts;
 }
 
-int main(int argc, char* argv[])
+/*---------------------------------------------------------------
+Writes whatever line solving can deduce for a puzzle that could
+not be solved, as a bitmap with unknown cells in gray and as
+text, next to outFileName. Also reports the lines that were found
+contradictory. 'gave_up' is set if the search stopped before
+trying every guess.
+---------------------------------------------------------------*/
+
+void writePartial(std::span<const std::vector<unsigned>> rowHints,
+                  std::span<const std::vector<unsigned>> colHints, bool gave_up,
+                  const std::string& outFileName)
 {
-	parseArgs(argc, argv);
-	const auto inFileName = argv[1];
+	nonagram partial(rowHints, colHints);
 
-	nonagram puzzle;
-
-	std::ifstream ifs(inFileName);
+	if (partial.deduce())
+	{
+		if (gave_up)
+			std::cerr << "Line solving alone found no contradiction.\n";
+		else
+			std::cerr << "Line solving alone found no contradiction, every guess led to one.\n";
+	}
 
-	if (!ifs.is_open())
+	for (const unsigned lin : partial.conflictingLines())
 	{
-		std::cerr << "Could not open file \"" << inFileName << "\" for reading.\n";
-		return 1;
+		if (lin < partial.rows())
+			std::cerr << "Contradiction in row " << lin << '\n';
+		else
+			std::cerr << "Contradiction in column " << (lin - partial.rows()) << '\n';
 	}
 
-	ifs >> puzzle;
+	const std::string bmpName =
+		std::filesystem::path(outFileName).replace_extension(".partial.bmp").string();
+	const std::string txtName =
+		std::filesystem::path(outFileName).replace_extension(".partial.txt").string();
 
-	ifs.close();
+	partial.bitmap().write(bmpName);
+
+	std::ofstream ofs(txtName);
+	partial.printGrid(ofs);
+
+	std::cerr << "Partial solution written to files \"" << bmpName << "\" and \"" << txtName
+			  << "\".\n";
+}
+
+int solveColor(std::istream& ifs, const std::string& outFileName)
+{
+	color_nonagram puzzle;
+
+	if (!(ifs >> puzzle))
+	{
+		std::cerr << "Malformed colored puzzle.\n";
+		return 1;
+	}
 
 	if (!puzzle.solve())
 	{
@@ -58,14 +140,105 @@ int main(int argc, char* argv[])
 		return 1;
 	}
 
+	puzzle.bitmap().write(outFileName);
+
+	std::cout << "Solution image written to file \"" << outFileName << "\"." << std::endl;
+	return 0;
+}
+
+int main(int argc, char* argv[])
+{
+	const auto opts = parseArgs(argc, argv);
+	const auto inFileName = opts.infile;
+
+	std::ifstream ifs(inFileName);
+
+	if (!ifs.is_open())
+	{
+		std::cerr << "Could not open file \"" << inFileName << "\" for reading.\n";
+		return 1;
+	}
+
 	// If the output file name is not given, generate one.
 	// by appending/replacing
 	// the file extention with ".bmp".
 	std::string outFileName =
-		(argc == 3) ? argv[2] : std::filesystem::path(inFileName).replace_extension(".bmp");
+		opts.outfile ? opts.outfile : std::filesystem::path(inFileName).replace_extension(".bmp");
+
+	if (isColorFormat(ifs))
+		return solveColor(ifs, outFileName);
+
+	std::vector<std::vector<unsigned>> rowHints, colHints;
+
+	if (!nonagram::readHints(ifs, rowHints, colHints))
+	{
+		std::cerr << "Malformed puzzle, or too large to index.\n";
+		return 1;
+	}
+
+	ifs.close();
+
+	if (const auto check = nonagram::checkHints(rowHints, colHints); !check)
+	{
+		std::cerr << "No solution: " << check << ".\n";
+		return 1;
+	}
+
+	nonagram puzzle(rowHints, colHints);
+
+	puzzle.setMemoryBudget(opts.memory_budget);
+
+	// The search saves its progress next to the output, and picks up from
+	// there with --resume.
+	if (opts.checkpoint != 0)
+	{
+		puzzle.setCheckpoint({std::filesystem::path(outFileName).replace_extension(".checkpoint"),
+		                      std::chrono::seconds(opts.checkpoint), opts.resume});
+	}
+
+#ifdef CPUZZLE_TRACE
+	// Written out however solving goes.
+	trace tr;
+	puzzle.setTrace(&tr);
+
+	struct trace_writer
+	{
+		const trace& tr;
+		std::string fileName;
+
+		~trace_writer()
+		{
+			std::ofstream(fileName) << tr;
+			std::cout << "Trace written to file \"" << fileName << "\"." << std::endl;
+		}
+	} writer{tr, std::filesystem::path(outFileName).replace_extension(".trace.json").string()};
+#endif
+
+	const bool solved = puzzle.solve();
+
+	if (puzzle.checkpointFailed())
+		std::cerr << "Could not write the checkpoint.\n";
+
+	if (!solved)
+	{
+		const bool gave_up = puzzle.exceededMemoryBudget();
+		if (gave_up)
+			std::cerr << "Gave up, the search would exceed the memory budget.\n";
+		else
+			std::cerr << "No solution.\n";
+
+		// solve() leaves the puzzle in an unspecified state on failure, so
+		// what line solving alone can deduce is worked out afresh, once the
+		// puzzle is gone.
+		puzzle = nonagram();
+		writePartial(rowHints, colHints, gave_up, outFileName);
+		return 1;
+	}
 
 	// Make .bmp file
 	puzzle.bitmap().write(outFileName);
 
 	std::cout << "Solution image written to file \"" << outFileName << "\"." << std::endl;
+	std::cout << "Peak memory: " << (peakMemory() >> 20) << " MB, of which the short line table "
+			  << (line_table::memoryUsage() >> 10) << " KB" << std::endl;
 }
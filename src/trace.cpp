@@ -0,0 +1,46 @@
+#include "trace.hpp"
+
+#include <algorithm>
+
+void trace::record(const char* name, char phase, clock::time_point start, clock::time_point end,
+                   std::vector<arg> args)
+{
+	std::lock_guard lock(mut);
+
+	// Number threads in the order they first record something.
+	const auto id = std::this_thread::get_id();
+	auto thread = std::ranges::find(threads, id);
+	if (thread == threads.end())
+		thread = threads.insert(threads.end(), id);
+
+	events.push_back({name, phase, static_cast<unsigned>(thread - threads.begin()),
+	                  start - epoch, end - start, std::move(args)});
+}
+
+std::ostream& operator<<(std::ostream& stream, const trace& tr)
+{
+	using microseconds = std::chrono::duration<double, std::micro>;
+
+	stream << "[\n";
+	for (std::size_t i = 0; i < tr.events.size(); ++i)
+	{
+		const auto& ev = tr.events[i];
+
+		stream << "{\"name\": \"" << ev.name << "\", \"ph\": \"" << ev.phase
+			   << "\", \"pid\": 1, \"tid\": " << ev.thread
+			   << ", \"ts\": " << microseconds(ev.start).count();
+
+		if (ev.phase == 'X')
+			stream << ", \"dur\": " << microseconds(ev.length).count();
+		else
+			stream << ", \"s\": \"t\"";
+
+		stream << ", \"args\": {";
+		for (std::size_t a = 0; a < ev.args.size(); ++a)
+		{
+			stream << (a ? ", \"" : "\"") << ev.args[a].first << "\": " << ev.args[a].second;
+		}
+		stream << (i + 1 < tr.events.size() ? "}},\n" : "}}\n");
+	}
+	return stream << "]\n";
+}
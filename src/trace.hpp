@@ -0,0 +1,88 @@
+#pragma once
+
+/*
+Collects timed events from solving a puzzle, and writes them in the Chrome
+trace event format, which chrome://tracing and Perfetto can open. Solving
+only records events in builds with CPUZZLE_TRACE defined (bazel build
+--config=trace), so that other builds pay nothing for it.
+
+Events may be recorded from several threads at once.
+*/
+
+#include <chrono>
+#include <mutex>
+#include <ostream>
+#include <thread>
+#include <utility>
+#include <vector>
+
+class trace
+{
+  public:
+	using clock = std::chrono::steady_clock;
+	using arg = std::pair<const char*, long long>;
+
+  private:
+	struct event
+	{
+		// Names are expected to be string literals.
+		const char* name;
+		// 'X' for an event with a duration, 'i' for an instant.
+		char phase;
+		unsigned thread;
+		clock::duration start, length;
+		std::vector<arg> args;
+	};
+
+	clock::time_point epoch = clock::now();
+
+	std::mutex mut;
+	std::vector<event> events;
+	std::vector<std::thread::id> threads;
+
+	void record(const char* name, char phase, clock::time_point start, clock::time_point end,
+	            std::vector<arg> args);
+
+  public:
+	// Records an event that lasted from start to end.
+	void complete(const char* name, clock::time_point start, clock::time_point end,
+	              std::vector<arg> args = {})
+	{
+		record(name, 'X', start, end, std::move(args));
+	}
+
+	// Records an event that happened now.
+	void instant(const char* name, std::vector<arg> args = {})
+	{
+		const auto now = clock::now();
+		record(name, 'i', now, now, std::move(args));
+	}
+
+	// Records an event lasting from its construction to its destruction, if
+	// given a trace at all.
+	class scope
+	{
+		trace* tr;
+		const char* name;
+		std::vector<arg> args;
+		clock::time_point start = clock::now();
+
+	  public:
+		scope(trace* t, const char* n, std::vector<arg> a = {})
+			: tr(t), name(n), args(std::move(a))
+		{
+		}
+
+		scope(const scope&) = delete;
+		scope& operator=(const scope&) = delete;
+
+		~scope()
+		{
+			if (tr)
+				tr->complete(name, start, clock::now(), std::move(args));
+		}
+	};
+
+	// Writes the events as a JSON array, in the order they were recorded.
+	friend std::ostream& operator<<(std::ostream& stream, const trace& tr);
+};
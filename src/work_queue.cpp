@@ -0,0 +1,290 @@
+#include "work_queue.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <fstream>
+#include <iterator>
+#include <ranges>
+#include <sstream>
+#include <system_error>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace stdfs = std::filesystem;
+
+namespace
+{
+constexpr const char* header = "nonagram-queue 1";
+
+std::string readFile(const stdfs::path& file)
+{
+	std::ifstream in(file, std::ios::binary);
+	return {std::istreambuf_iterator<char>(in), {}};
+}
+
+// Writes a file whole under a temporary name, then renames it into place,
+// replacing any file already there.
+bool replaceFile(const stdfs::path& file, const std::string& temp_suffix,
+                 const std::string& contents)
+{
+	auto temp = file;
+	temp += temp_suffix;
+	{
+		std::ofstream out(temp, std::ios::binary);
+		out << contents;
+		out.close();
+		if (!out)
+			return false;
+	}
+
+	std::error_code ec;
+	stdfs::rename(temp, file, ec);
+	return !ec;
+}
+} // namespace
+
+work_queue::work_queue(stdfs::path directory, std::chrono::seconds lease)
+	: dir(std::move(directory)), lease_time(lease)
+{
+	char host[256] = {};
+	gethostname(host, sizeof(host) - 1);
+	owner = std::string(host) + '.' + std::to_string(getpid());
+
+	renewer = std::thread([this] { renew(); });
+}
+
+work_queue::~work_queue()
+{
+	{
+		std::lock_guard lock(mut);
+		stopping = true;
+	}
+	changed.notify_all();
+	renewer.join();
+}
+
+stdfs::path work_queue::leaseFile(unsigned shard) const
+{
+	return dir / (std::to_string(shard) + ".lease");
+}
+
+stdfs::path work_queue::resultsFile(unsigned shard) const
+{
+	return dir / (std::to_string(shard) + ".csv");
+}
+
+bool work_queue::readManifest()
+{
+	std::ifstream in(dir / "manifest");
+	std::string line;
+	std::size_t count;
+	if (!std::getline(in, line) || line != header || !(in >> count))
+		return false;
+
+	shards.clear();
+	for (; count > 0; --count)
+	{
+		std::size_t files;
+		if (!(in >> files) || !in.ignore())
+			return false;
+
+		auto& shard = shards.emplace_back();
+		for (; files > 0 && std::getline(in, line); --files)
+			shard.push_back(line);
+		if (files != 0)
+			return false;
+	}
+	return true;
+}
+
+bool work_queue::open(std::span<const std::string> files, unsigned shard_size)
+{
+	std::error_code ec;
+	stdfs::create_directories(dir, ec);
+	if (ec)
+		return false;
+
+	// A manifest left from another batch must not be taken for this one.
+	if (readManifest())
+		return std::ranges::equal(std::views::join(shards), files);
+
+	shard_size = std::max(shard_size, 1u);
+	const std::size_t count = (files.size() + shard_size - 1) / shard_size;
+
+	std::ostringstream manifest;
+	manifest << header << '\n' << count << '\n';
+	for (std::size_t first = 0; first < files.size(); first += shard_size)
+	{
+		const auto shard =
+			files.subspan(first, std::min<std::size_t>(shard_size, files.size() - first));
+		manifest << shard.size() << '\n';
+		for (const auto& file : shard)
+			manifest << file << '\n';
+	}
+
+	// A hard link is only made if nothing has the name yet, so of several
+	// processes starting at once, only one manifest is used.
+	auto temp = dir / "manifest";
+	temp += '.' + owner;
+	{
+		std::ofstream out(temp);
+		out << std::move(manifest).str();
+		out.close();
+		if (!out)
+			return false;
+	}
+	stdfs::create_hard_link(temp, dir / "manifest", ec);
+	stdfs::remove(temp, ec);
+
+	return readManifest();
+}
+
+bool work_queue::breakLease(const stdfs::path& lease)
+{
+	std::error_code ec;
+	const auto touched = stdfs::last_write_time(lease, ec);
+	if (ec || file_clock::now() - touched < lease_time)
+		return false;
+
+	// Its process is taken to have died. Of several processes taking the
+	// lease over at once, only one manages to rename it away, the others
+	// find it gone.
+	auto stale = lease;
+	stale += '.' + owner;
+	stdfs::rename(lease, stale, ec);
+	if (ec)
+		return false;
+
+	// Another process may have taken the shard over, and made a fresh lease,
+	// since this one was found expired. If so, it is put back, unless yet
+	// another process made a lease in the meantime, in which case the shard
+	// may be solved twice.
+	const auto renamed = stdfs::last_write_time(stale, ec);
+	const bool expired = !ec && file_clock::now() - renamed >= lease_time;
+	if (!expired)
+		stdfs::create_hard_link(stale, lease, ec);
+
+	stdfs::remove(stale, ec);
+	return expired;
+}
+
+bool work_queue::tryClaim(unsigned shard)
+{
+	const auto lease = leaseFile(shard);
+
+	// Makes a new lease. Fails with errno EEXIST if there already is one.
+	const auto create = [&]
+	{
+		const int fd = ::open(lease.c_str(), O_WRONLY | O_CREAT | O_EXCL, 0644);
+		if (fd < 0)
+			return false;
+
+		const bool written = write(fd, owner.data(), owner.size()) == ssize_t(owner.size());
+		::close(fd);
+		if (!written)
+		{
+			std::error_code ec;
+			stdfs::remove(lease, ec);
+			errno = EIO;
+		}
+		return written;
+	};
+
+	// An expired lease is taken over by making a new one, which can only
+	// fail if another process made it first.
+	if (!create() && (errno != EEXIST || !breakLease(lease) || !create()))
+		return false;
+
+	// The shard may have been finished by a process whose lease had run out.
+	std::error_code ec;
+	if (stdfs::exists(resultsFile(shard), ec))
+	{
+		stdfs::remove(lease, ec);
+		return false;
+	}
+	return true;
+}
+
+std::optional<unsigned> work_queue::claim()
+{
+	using std::chrono::milliseconds;
+	const auto poll = std::clamp<milliseconds>(milliseconds(lease_time) / 4, milliseconds(100),
+	                                           milliseconds(5000));
+	while (true)
+	{
+		bool waiting = false;
+		for (unsigned shard = 0; shard < shards.size(); ++shard)
+		{
+			std::error_code ec;
+			if (stdfs::exists(resultsFile(shard), ec))
+				continue;
+
+			if (tryClaim(shard))
+			{
+				{
+					std::lock_guard lock(mut);
+					held = shard;
+				}
+				changed.notify_all();
+				return shard;
+			}
+			waiting = true;
+		}
+
+		if (!waiting)
+			return std::nullopt;
+		std::this_thread::sleep_for(poll);
+	}
+}
+
+bool work_queue::complete(unsigned shard, const std::string& results)
+{
+	{
+		std::lock_guard lock(mut);
+		held.reset();
+	}
+
+	if (!replaceFile(resultsFile(shard), '.' + owner, results))
+		return false;
+
+	// Unless another process has taken the shard over meanwhile.
+	const auto lease = leaseFile(shard);
+	if (readFile(lease) == owner)
+	{
+		std::error_code ec;
+		stdfs::remove(lease, ec);
+	}
+	return true;
+}
+
+std::vector<std::string> work_queue::results() const
+{
+	std::vector<std::string> all;
+	for (unsigned shard = 0; shard < shards.size(); ++shard)
+		all.push_back(readFile(resultsFile(shard)));
+	return all;
+}
+
+/*-------------------------------------------------------------
+Touches the lease of the shard being worked on a few times per
+lease time, as long as it is still this process's lease.
+-------------------------------------------------------------*/
+
+void work_queue::renew()
+{
+	std::unique_lock lock(mut);
+	while (!stopping)
+	{
+		changed.wait_for(lock, std::chrono::milliseconds(lease_time) / 4);
+		if (!held || stopping)
+			continue;
+
+		const auto lease = leaseFile(*held);
+		if (readFile(lease) == owner)
+		{
+			std::error_code ec;
+			stdfs::last_write_time(lease, file_clock::now(), ec);
+		}
+	}
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+/*
+Shares out the puzzles of a batch between several batch_solver processes,
+through a directory they all see: on one host, or on several mounting the
+same file system. Nothing but the files in the directory is shared, and
+every change to them is a single atomic create or rename, so processes may
+start, stop or crash at any point.
+
+The input files are split into shards, whose contents the first process to
+arrive writes to "manifest"; later ones use its split, so that all agree on
+it. A process works on a shard while it holds its lease, "<shard>.lease",
+which it creates only if absent and keeps touching while it works. A lease
+left untouched for longer than the lease time is taken to belong to a
+process that died, and is taken over by renaming it away, which only one
+process manages, and creating it afresh. Once done, a process records the
+results of its shard as "<shard>.csv", which marks the shard as done, and
+drops the lease.
+
+A shard whose lease expired while its process was merely slow may be solved
+twice, to the same results. Lease times should be well above the clock skew
+between hosts, as leases are aged by file modification times.
+*/
+
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <thread>
+#include <vector>
+
+class work_queue
+{
+	using file_clock = std::filesystem::file_time_type::clock;
+
+	std::filesystem::path dir;
+	std::chrono::seconds lease_time;
+
+	// Host name and process ID, written into the leases it holds.
+	std::string owner;
+
+	std::vector<std::vector<std::string>> shards;
+
+	// The shard whose lease is being kept fresh, if any.
+	std::mutex mut;
+	std::condition_variable changed;
+	std::optional<unsigned> held;
+	bool stopping = false;
+	std::thread renewer;
+
+	std::filesystem::path leaseFile(unsigned shard) const;
+	std::filesystem::path resultsFile(unsigned shard) const;
+
+	[[nodiscard]] bool readManifest();
+	[[nodiscard]] bool breakLease(const std::filesystem::path& lease);
+	[[nodiscard]] bool tryClaim(unsigned shard);
+	void renew();
+
+  public:
+	work_queue(std::filesystem::path directory, std::chrono::seconds lease);
+
+	work_queue(const work_queue&) = delete;
+	work_queue& operator=(const work_queue&) = delete;
+
+	~work_queue();
+
+	// Splits 'files' into shards of up to 'shard_size', unless the directory
+	// already has a manifest for the same files, in which case that is used.
+	// Returns false if the directory cannot be used, or has a manifest for
+	// other files.
+	[[nodiscard]] bool open(std::span<const std::string> files, unsigned shard_size);
+
+	// Names this process in the directory, unique across hosts.
+	const std::string& id() const { return owner; }
+
+	std::size_t size() const { return shards.size(); }
+	std::span<const std::string> files(unsigned shard) const { return shards[shard]; }
+
+	// Claims a shard that is neither done nor leased, waiting while every
+	// shard left is leased by another process. Returns nothing once every
+	// shard is done.
+	std::optional<unsigned> claim();
+
+	// Records the results of the shard claimed last, marking it done, and
+	// drops its lease. Returns false if they could not be written.
+	[[nodiscard]] bool complete(unsigned shard, const std::string& results);
+
+	// The results of every shard, in order. Only once claim() returns nothing.
+	std::vector<std::string> results() const;
+};
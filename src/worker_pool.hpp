@@ -0,0 +1,117 @@
+#pragma once
+
+/*
+A thread pool whose workers each keep a context of their own for as long as
+the pool lives, so that tasks can reuse buffers from one to the next instead
+of allocating them afresh. Workers can be pinned one to a CPU, in the order
+spreadCpus() gives, and the pool counts the tasks each worker ran and how
+long it spent on them.
+
+Tasks are handed their worker's context, which no other task uses while they
+run. A worker's context is made the first time it picks up a task.
+*/
+
+#include "cpu_topology.hpp"
+
+#include "ctpl_stl.h"
+
+#include <chrono>
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <utility>
+#include <vector>
+
+template <typename Context>
+class worker_pool
+{
+  public:
+	using clock = std::chrono::steady_clock;
+
+	struct worker
+	{
+		Context context;
+
+		// The CPU the worker is pinned to, if it is.
+		std::optional<unsigned> cpu;
+		std::uint64_t tasks = 0;
+		clock::duration busy{};
+	};
+
+  private:
+	std::vector<unsigned> cpus;
+	clock::time_point started = clock::now();
+
+	std::mutex mut;
+	std::vector<std::unique_ptr<worker>> workers;
+	std::vector<std::future<void>> pending;
+
+	// Declared last, so that its threads are joined before anything they use
+	// goes away.
+	ctpl::thread_pool pool;
+
+	worker& local()
+	{
+		// Threads belong to one pool, so a thread only ever needs one worker.
+		thread_local worker* own = nullptr;
+		if (own)
+			return *own;
+
+		std::lock_guard lock(mut);
+		own = workers.emplace_back(std::make_unique<worker>()).get();
+		if (!cpus.empty())
+		{
+			const unsigned cpu = cpus[(workers.size() - 1) % cpus.size()];
+			if (pinToCpu(cpu))
+				own->cpu = cpu;
+		}
+		return *own;
+	}
+
+  public:
+	// Runs 'threads' workers, pinned to CPUs if 'pin' is set.
+	worker_pool(unsigned threads, bool pin)
+		: cpus(pin ? spreadCpus() : std::vector<unsigned>{}), pool(static_cast<int>(threads))
+	{
+	}
+
+	// Queues task(context), to be run by whichever worker is free first.
+	template <typename Task>
+	void push(Task&& task)
+	{
+		auto done = pool.push(
+			[this, task = std::forward<Task>(task)](auto&&...) mutable
+			{
+				auto& self = local();
+				const auto start = clock::now();
+				task(self.context);
+				self.busy += clock::now() - start;
+				++self.tasks;
+			});
+
+		std::lock_guard lock(mut);
+		pending.push_back(std::move(done));
+	}
+
+	// Waits for every task queued so far. Only to be called from outside the
+	// pool's tasks.
+	void wait()
+	{
+		std::vector<std::future<void>> waiting;
+		{
+			std::lock_guard lock(mut);
+			waiting.swap(pending);
+		}
+		for (auto& done : waiting)
+			done.wait();
+	}
+
+	// Time since the pool started, against which workers' busy times count.
+	clock::duration uptime() const { return clock::now() - started; }
+
+	// The workers that have run a task, in the order they first did. Only to
+	// be called between wait() and queuing more tasks.
+	const std::vector<std::unique_ptr<worker>>& stats() const { return workers; }
+};